@@ -4,6 +4,7 @@
 #include "System/AppEngineBase.h"
 #include "System/CommandQueue.h"
 #include "System/AppWindow.h"
+#include "System/Descriptors/ThreadDescriptorCache.h"
 
 #include <map>
 
@@ -19,8 +20,6 @@ static WindowNameMap g_WindowByName;
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-uint64_t Application::m_FrameCount = 0;
-
 struct MakeWindow : public AppWindow
 {
 	MakeWindow(HWND hWnd, const std::wstring& windowName, UINT clientWidth, UINT clientHeight, bool vsync)
@@ -35,14 +34,14 @@ void Application::Flush()
 	m_CopyCommandQueue->Flush();
 }
 
-ComPtr<ID3D12DescriptorHeap> Application::CreateDescriptorHeap(UINT numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type)
+ComPtr<ID3D12DescriptorHeap> Application::CreateDescriptorHeap(UINT numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags)
 {
 	ComPtr<ID3D12DescriptorHeap> descriptorHeap;
 
 	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
 	desc.NumDescriptors = numDescriptors;
 	desc.Type = type;
-	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	desc.Flags = flags;
 	desc.NodeMask = 0;
 
 	ThrowIfFailed(m_Device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&descriptorHeap)));
@@ -94,10 +93,10 @@ void Application::Initialise()
 		MessageBoxA(nullptr, "Unable to register the window class", "Error", MB_OK | MB_ICONERROR);
 	}
 
-	auto dxgiAdapter = GetAdapter();
-	if (dxgiAdapter)
+	m_Adapter = GetAdapter();
+	if (m_Adapter)
 	{
-		m_Device = CreateDevice(dxgiAdapter);
+		m_Device = CreateDevice(m_Adapter);
 	}
 
 	m_DirectCommandQueue = std::make_shared<CommandQueue>(D3D12_COMMAND_LIST_TYPE_DIRECT);
@@ -210,12 +209,19 @@ Application& Application::Get()
 	return *g_App;
 }
 
+bool Application::IsCreated()
+{
+	return g_App != nullptr;
+}
+
 void Application::Destroy()
 {
 	if (g_App)
 	{
 		assert(g_Windows.empty() && g_WindowByName.empty() && "All windows must be destroyed first");
 
+		ThreadDescriptorCache::Flush();
+
 		delete g_App;
 		g_App = nullptr;
 	}
@@ -16,6 +16,7 @@ public:
 	static void Destroy();
 
 	static Application& Get();
+	static bool IsCreated();
 
 	std::shared_ptr<AppWindow> CreateRenderWindow(const std::wstring& windowName, UINT clientWidth, UINT clientHeight, bool vsync);
 
@@ -28,17 +29,17 @@ public:
 	void Quit(int exitCode = 0);
 
 	ComPtr<ID3D12Device2> GetDevice() const;
+	ComPtr<IDXGIAdapter4> GetDXGIAdapter() const { return m_Adapter; }
 	std::shared_ptr<CommandQueue> GetCommandQueue(D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT) const;
 
 	void Flush();
 
-	ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(UINT numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type);
+	ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(UINT numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type,
+		D3D12_DESCRIPTOR_HEAP_FLAGS flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
 	UINT GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE type) const;
 
 	bool IsTearingSupported() const { return m_TearingSupported; }
 
-	static uint64_t GetFrameCount() { return m_FrameCount; }
-
 protected:
 	Application(HINSTANCE hInst);
 	virtual ~Application();
@@ -54,6 +55,7 @@ private:
 	Application& operator=(const Application& other) = delete;
 
 	HINSTANCE m_hInstance;
+	ComPtr<IDXGIAdapter4> m_Adapter;
 	ComPtr<ID3D12Device2> m_Device;
 
 	std::shared_ptr<CommandQueue> m_DirectCommandQueue;
@@ -61,7 +63,5 @@ private:
 	std::shared_ptr<CommandQueue> m_CopyCommandQueue;
 
 	bool m_TearingSupported;
-
-	static uint64_t m_FrameCount;
 };
 
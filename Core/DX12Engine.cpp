@@ -2,6 +2,10 @@
 #include "Application.h"
 #include "Globals/Helpers.h"
 #include "System/CommandQueue.h"
+#include "System/StreamingUploader.h"
+#include "System/Memory/ResidencyManager.h"
+#include "System/Memory/ResourceAllocator.h"
+#include "System/Descriptors/BindlessDescriptorHeap.h"
 
 using namespace DirectX;
 
@@ -51,6 +55,11 @@ DX12Engine::DX12Engine(const std::wstring& name, UINT width, UINT height, bool v
 	, m_Viewport(CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)))
 	, m_ScissorRect(CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX))
 	, m_toggleCooldown(0.0f)
+	, m_MaterialIndex(BindlessDescriptorHeap::InvalidIndex)
+{
+}
+
+DX12Engine::~DX12Engine()
 {
 }
 
@@ -58,19 +67,27 @@ bool DX12Engine::LoadContent()
 {
 	auto device = Application::Get().GetDevice();
 	auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
-	auto commandList = commandQueue->GetCommandList();
 
-	ComPtr<ID3D12Resource> intermediateVertexBuffer;
-	UpdateBufferResource(commandList, &m_VertexBuffer, &intermediateVertexBuffer, _countof(Vertices), sizeof(VertexPosColour), Vertices);
+	if (!m_Uploader)
+	{
+		m_Uploader = std::make_unique<StreamingUploader>(commandQueue);
+	}
+
+	if (!m_ResourceAllocator)
+	{
+		m_ResidencyManager = std::make_unique<ResidencyManager>(Application::Get().GetDXGIAdapter());
+		m_ResourceAllocator = std::make_unique<ResourceAllocator>(_64MB, m_ResidencyManager.get());
+	}
+
+	UpdateBufferResource(m_VertexBuffer, _countof(Vertices), sizeof(VertexPosColour), Vertices);
 
-	m_VertexBufferView.BufferLocation = m_VertexBuffer->GetGPUVirtualAddress();
+	m_VertexBufferView.BufferLocation = m_VertexBuffer.GetResource()->GetGPUVirtualAddress();
 	m_VertexBufferView.SizeInBytes = sizeof(Vertices);
 	m_VertexBufferView.StrideInBytes = sizeof(VertexPosColour);
 
-	ComPtr<ID3D12Resource> intermediateIndexBuffer;
-	UpdateBufferResource(commandList, &m_IndexBuffer, &intermediateIndexBuffer, _countof(Indices), sizeof(WORD), Indices);
+	UpdateBufferResource(m_IndexBuffer, _countof(Indices), sizeof(WORD), Indices);
 
-	m_IndexBufferView.BufferLocation = m_IndexBuffer->GetGPUVirtualAddress();
+	m_IndexBufferView.BufferLocation = m_IndexBuffer.GetResource()->GetGPUVirtualAddress();
 	m_IndexBufferView.SizeInBytes = sizeof(Indices);
 	m_IndexBufferView.Format = DXGI_FORMAT_R16_UINT;
 
@@ -150,8 +167,16 @@ bool DX12Engine::LoadContent()
 
 	ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_PipelineState)));
 
-	auto fenceValue = commandQueue->ExecuteCommandList(commandList);
-	commandQueue->WaitForFenceValue(fenceValue);
+	LoadBindlessContent(vertexShaderBlob, { inputLayout, _countof(inputLayout) });
+
+	// Draws wait for the uploads on the GPU rather than stalling here. The
+	// destinations stay resident until the copy queue is done with them.
+	uint64_t uploadFenceValue = m_Uploader->Submit();
+	m_ResidencyManager->MarkUsed(m_VertexBuffer.GetHeap(), *commandQueue, uploadFenceValue);
+	m_ResidencyManager->MarkUsed(m_IndexBuffer.GetHeap(), *commandQueue, uploadFenceValue);
+
+	auto directQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	directQueue->Wait(*commandQueue, uploadFenceValue);
 
 	m_ContentLoaded = true;
 
@@ -162,6 +187,12 @@ bool DX12Engine::LoadContent()
 
 void DX12Engine::UnloadContent()
 {
+	if (m_BindlessHeap)
+	{
+		m_BindlessHeap->Release(m_MaterialIndex);
+		m_MaterialIndex = BindlessDescriptorHeap::InvalidIndex;
+	}
+
 	m_ContentLoaded = false;
 }
 
@@ -207,14 +238,29 @@ void DX12Engine::OnRender(RenderEvent& e)
 
 	// Clear render targets
 	{
-		TransitionResource(commandList, backBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_StateTracker.TransitionResource(backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_StateTracker.FlushResourceBarriers(commandList.Get());
+
 		FLOAT clearColour[] = { 0.4f, 0.6f, 0.9f, 1.0f };
 		ClearRTV(commandList, rtv, clearColour);
 		ClearDepth(commandList, dsv);
 	}
 
-	commandList->SetPipelineState(m_PipelineState.Get());
-	commandList->SetGraphicsRootSignature(m_RootSignature.Get());
+	if (m_BindlessPipelineState)
+	{
+		// The heap has to be bound before a directly indexed root signature is set.
+		ID3D12DescriptorHeap* descriptorHeaps[] = { m_BindlessHeap->GetDescriptorHeap() };
+		commandList->SetDescriptorHeaps(1, descriptorHeaps);
+
+		commandList->SetPipelineState(m_BindlessPipelineState.Get());
+		commandList->SetGraphicsRootSignature(m_BindlessRootSignature.Get());
+		commandList->SetGraphicsRoot32BitConstant(1, m_MaterialIndex, 0);
+	}
+	else
+	{
+		commandList->SetPipelineState(m_PipelineState.Get());
+		commandList->SetGraphicsRootSignature(m_RootSignature.Get());
+	}
 
 	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	commandList->IASetVertexBuffers(0, 1, &m_VertexBufferView);
@@ -229,13 +275,24 @@ void DX12Engine::OnRender(RenderEvent& e)
 	mvpMatrix = XMMatrixMultiply(mvpMatrix, m_ProjMatrix);
 	commandList->SetGraphicsRoot32BitConstants(0, sizeof(XMMATRIX) / 4, &mvpMatrix, 0);
 
+	m_StateTracker.FlushResourceBarriers(commandList.Get());
 	commandList->DrawIndexedInstanced(_countof(Indices), 1, 0, 0, 0);
 
 	// Present
 	{
-		TransitionResource(commandList, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-		
-		m_FenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandList(commandList);
+		m_StateTracker.TransitionResource(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+		m_StateTracker.FlushResourceBarriers(commandList.Get());
+
+		// The frame's fence value is only known once it is submitted.
+		m_ResidencyManager->MarkUsedPending(m_VertexBuffer.GetHeap(), *commandQueue);
+		m_ResidencyManager->MarkUsedPending(m_IndexBuffer.GetHeap(), *commandQueue);
+		m_ResidencyManager->MarkUsedPending(m_DepthBuffer.GetHeap(), *commandQueue);
+		m_ResidencyManager->Update(*commandQueue);
+
+		const ComPtr<ID3D12GraphicsCommandList2> commandLists[] = { commandList };
+		ResourceStateTracker* const stateTrackers[] = { &m_StateTracker };
+		m_FenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandLists(commandLists, stateTrackers, 1);
+		m_ResidencyManager->ResolvePendingMarks(*commandQueue, m_FenceValues[currentBackBufferIndex]);
 
 		currentBackBufferIndex = m_AppWindow->Present();
 		commandQueue->WaitForFenceValue(m_FenceValues[currentBackBufferIndex]);
@@ -292,12 +349,6 @@ void DX12Engine::OnResize(UINT width, UINT height)
 	}
 }
 
-void DX12Engine::TransitionResource(ComPtr<ID3D12GraphicsCommandList2> commandList, ComPtr<ID3D12Resource> resource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState)
-{
-	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(), beforeState, afterState);
-	commandList->ResourceBarrier(1, &barrier);
-}
-
 void DX12Engine::ClearRTV(ComPtr<ID3D12GraphicsCommandList2> commandList, D3D12_CPU_DESCRIPTOR_HANDLE rtv, FLOAT* clearColour)
 {
 	commandList->ClearRenderTargetView(rtv, clearColour, 0, nullptr);
@@ -308,43 +359,17 @@ void DX12Engine::ClearDepth(ComPtr<ID3D12GraphicsCommandList2> commandList, D3D1
 	commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
 }
 
-void DX12Engine::UpdateBufferResource(ComPtr<ID3D12GraphicsCommandList2> commandList, ID3D12Resource** destinationResource, ID3D12Resource** intermediateResource, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags)
+void DX12Engine::UpdateBufferResource(ResourceAllocation& destination, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags)
 {
-	auto device = Application::Get().GetDevice();
-
 	size_t bufferSize = numElements * elementSize;
 
-	const CD3DX12_HEAP_PROPERTIES HeapProperties(D3D12_HEAP_TYPE_DEFAULT);
 	const CD3DX12_RESOURCE_DESC Buffer(CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags));
 
-	ThrowIfFailed(device->CreateCommittedResource(
-		&HeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&Buffer,
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(destinationResource)));
+	destination = m_ResourceAllocator->CreateResource(D3D12_HEAP_TYPE_DEFAULT, Buffer, D3D12_RESOURCE_STATE_COPY_DEST);
 
 	if (bufferData)
 	{
-		const CD3DX12_HEAP_PROPERTIES UploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
-		const CD3DX12_RESOURCE_DESC UploadBuffer(CD3DX12_RESOURCE_DESC::Buffer(bufferSize));
-
-		ThrowIfFailed(device->CreateCommittedResource(
-			&UploadHeapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&UploadBuffer,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(intermediateResource)));
-
-		D3D12_SUBRESOURCE_DATA subresourceData = {};
-		subresourceData.pData = bufferData;
-		subresourceData.RowPitch = bufferSize;
-		subresourceData.SlicePitch = subresourceData.RowPitch;
-
-		UpdateSubresources(commandList.Get(), *destinationResource, *intermediateResource,
-			0, 0, 1, &subresourceData);
+		m_Uploader->UploadBuffer(destination.GetResource(), 0, bufferData, bufferSize);
 	}
 }
 
@@ -363,16 +388,11 @@ void DX12Engine::ResizeDepthBuffer(UINT width, UINT height)
 		optimisedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
 		optimisedClearValue.DepthStencil = { 1.0f, 0 };
 
-		const CD3DX12_HEAP_PROPERTIES HeapProperties(D3D12_HEAP_TYPE_DEFAULT);
 		const CD3DX12_RESOURCE_DESC Tex2D(CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, width, height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
 
-		ThrowIfFailed(device->CreateCommittedResource(
-			&HeapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&Tex2D,
-			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			&optimisedClearValue,
-			IID_PPV_ARGS(&m_DepthBuffer)));
+		// The flush above means the old depth buffer's range can be reused now.
+		m_DepthBuffer.Release();
+		m_DepthBuffer = m_ResourceAllocator->CreateResource(D3D12_HEAP_TYPE_DEFAULT, Tex2D, D3D12_RESOURCE_STATE_DEPTH_WRITE, &optimisedClearValue);
 
 		D3D12_DEPTH_STENCIL_VIEW_DESC dsv = {};
 		dsv.Format = DXGI_FORMAT_D32_FLOAT;
@@ -380,6 +400,102 @@ void DX12Engine::ResizeDepthBuffer(UINT width, UINT height)
 		dsv.Texture2D.MipSlice = 0;
 		dsv.Flags = D3D12_DSV_FLAG_NONE;
 
-		device->CreateDepthStencilView(m_DepthBuffer.Get(), &dsv, m_DSVHeap->GetCPUDescriptorHandleForHeapStart());
+		device->CreateDepthStencilView(m_DepthBuffer.GetResource(), &dsv, m_DSVHeap->GetCPUDescriptorHandleForHeapStart());
 	}
 }
+
+void DX12Engine::LoadBindlessContent(ComPtr<ID3DBlob> vertexShaderBlob, const D3D12_INPUT_LAYOUT_DESC& inputLayout)
+{
+	auto device = Application::Get().GetDevice();
+
+	D3D12_FEATURE_DATA_SHADER_MODEL shaderModel = { D3D_SHADER_MODEL_6_6 };
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shaderModel, sizeof(shaderModel))) ||
+		shaderModel.HighestShaderModel < D3D_SHADER_MODEL_6_6 ||
+		FAILED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) ||
+		options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_3)
+	{
+		return;
+	}
+
+	ComPtr<ID3DBlob> pixelShaderBlob;
+	if (FAILED(D3DReadFileToBlob(L"BindlessPixelShader.cso", &pixelShaderBlob)))
+	{
+		return;
+	}
+
+	m_BindlessHeap = std::make_shared<BindlessDescriptorHeap>();
+
+	const CD3DX12_HEAP_PROPERTIES UploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+	const CD3DX12_RESOURCE_DESC MaterialBuffer(CD3DX12_RESOURCE_DESC::Buffer(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT));
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&UploadHeapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&MaterialBuffer,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_MaterialBuffer)));
+
+	XMFLOAT4* tint = nullptr;
+	ThrowIfFailed(m_MaterialBuffer->Map(0, nullptr, reinterpret_cast<void**>(&tint)));
+	*tint = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	m_MaterialBuffer->Unmap(0, nullptr);
+
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+	cbvDesc.BufferLocation = m_MaterialBuffer->GetGPUVirtualAddress();
+	cbvDesc.SizeInBytes = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+	m_MaterialIndex = m_BindlessHeap->RegisterConstantBufferView(&cbvDesc);
+
+	D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+		D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+
+	CD3DX12_ROOT_PARAMETER1 rootParameters[2];
+	rootParameters[0].InitAsConstants(sizeof(XMMATRIX) / 4, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootParameters[1].InitAsConstants(1, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+	rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, rootSignatureFlags);
+
+	ComPtr<ID3DBlob> rootSignatureBlob;
+	ComPtr<ID3DBlob> errorBlob;
+	ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription,
+		D3D_ROOT_SIGNATURE_VERSION_1_1, &rootSignatureBlob, &errorBlob));
+
+	ThrowIfFailed(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+		rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_BindlessRootSignature)));
+
+	struct PipelineStateStream
+	{
+		CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE pRootSignature;
+		CD3DX12_PIPELINE_STATE_STREAM_INPUT_LAYOUT InputLayout;
+		CD3DX12_PIPELINE_STATE_STREAM_PRIMITIVE_TOPOLOGY PrimitiveTopologyType;
+		CD3DX12_PIPELINE_STATE_STREAM_VS VS;
+		CD3DX12_PIPELINE_STATE_STREAM_PS PS;
+		CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL_FORMAT DSVFormat;
+		CD3DX12_PIPELINE_STATE_STREAM_RENDER_TARGET_FORMATS RTVFormats;
+	} pipelineStateStream;
+
+	D3D12_RT_FORMAT_ARRAY rtvFormats = {};
+	rtvFormats.NumRenderTargets = 1;
+	rtvFormats.RTFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	pipelineStateStream.pRootSignature = m_BindlessRootSignature.Get();
+	pipelineStateStream.InputLayout = inputLayout;
+	pipelineStateStream.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	pipelineStateStream.VS = CD3DX12_SHADER_BYTECODE(vertexShaderBlob.Get());
+	pipelineStateStream.PS = CD3DX12_SHADER_BYTECODE(pixelShaderBlob.Get());
+	pipelineStateStream.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+	pipelineStateStream.RTVFormats = rtvFormats;
+
+	D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc =
+	{
+		sizeof(PipelineStateStream), &pipelineStateStream
+	};
+
+	ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_BindlessPipelineState)));
+}
\ No newline at end of file
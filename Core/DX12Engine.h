@@ -2,6 +2,14 @@
 #include "Globals/stdafx.h"
 #include "System/AppEngineBase.h"
 #include "System/AppWindow.h"
+#include "System/ResourceStateTracker.h"
+#include "System/Memory/ResourceAllocator.h"
+
+#include <memory>
+
+class BindlessDescriptorHeap;
+class ResidencyManager;
+class StreamingUploader;
 
 
 class DX12Engine : public AppEngineBase
@@ -10,6 +18,7 @@ public:
 	using super = AppEngineBase;
 
 	DX12Engine(const std::wstring& name, UINT width, UINT height, bool vsync = false);
+	virtual ~DX12Engine();
 	
 	virtual bool LoadContent() override;
 	virtual void UnloadContent() override;
@@ -23,37 +32,47 @@ protected:
 	virtual void OnResize(UINT width, UINT height) override;
 
 private:
-	void TransitionResource(ComPtr<ID3D12GraphicsCommandList2> commandList,
-		ComPtr<ID3D12Resource> resource,
-		D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState);
-
 	void ClearRTV(ComPtr<ID3D12GraphicsCommandList2> commandList,
 		D3D12_CPU_DESCRIPTOR_HANDLE rtv, FLOAT* clearColour);
 
 	void ClearDepth(ComPtr<ID3D12GraphicsCommandList2> commandList,
 		D3D12_CPU_DESCRIPTOR_HANDLE dsv, FLOAT depth = 1.0f);
 
-	void UpdateBufferResource(ComPtr<ID3D12GraphicsCommandList2> commandList,
-		ID3D12Resource** destinationResource, ID3D12Resource** intermediateResource,
+	void UpdateBufferResource(ResourceAllocation& destination,
 		size_t numElements, size_t elementSize, const void* bufferData,
 		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 
 	void ResizeDepthBuffer(UINT width, UINT height);
 
+	void LoadBindlessContent(ComPtr<ID3DBlob> vertexShaderBlob, const D3D12_INPUT_LAYOUT_DESC& inputLayout);
+
 	uint64_t m_FenceValues[AppWindow::BufferCount] = {};
 
-	ComPtr<ID3D12Resource> m_VertexBuffer;
+	ResourceStateTracker m_StateTracker;
+
+	std::unique_ptr<StreamingUploader> m_Uploader;
+	std::unique_ptr<ResidencyManager> m_ResidencyManager;
+	std::unique_ptr<ResourceAllocator> m_ResourceAllocator;
+
+	ResourceAllocation m_VertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW m_VertexBufferView;
-	ComPtr<ID3D12Resource> m_IndexBuffer;
+	ResourceAllocation m_IndexBuffer;
 	D3D12_INDEX_BUFFER_VIEW m_IndexBufferView;
 
-	ComPtr<ID3D12Resource> m_DepthBuffer;
+	ResourceAllocation m_DepthBuffer;
 	ComPtr<ID3D12DescriptorHeap> m_DSVHeap;
 
 	ComPtr<ID3D12RootSignature> m_RootSignature;
 
 	ComPtr<ID3D12PipelineState> m_PipelineState;
 
+	// Only created when the device supports SM 6.6 and resource binding tier 3.
+	std::shared_ptr<BindlessDescriptorHeap> m_BindlessHeap;
+	ComPtr<ID3D12RootSignature> m_BindlessRootSignature;
+	ComPtr<ID3D12PipelineState> m_BindlessPipelineState;
+	ComPtr<ID3D12Resource> m_MaterialBuffer;
+	uint32_t m_MaterialIndex;
+
 	D3D12_VIEWPORT m_Viewport;
 	D3D12_RECT m_ScissorRect;
 
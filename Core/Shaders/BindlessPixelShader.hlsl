@@ -0,0 +1,22 @@
+struct PixelShaderInput
+{
+	float4 Colour : COLOR;
+};
+
+struct Material
+{
+	float4 Tint;
+};
+
+struct BindlessIndices
+{
+	uint MaterialIndex;
+};
+
+ConstantBuffer<BindlessIndices> BindlessIndicesCB : register(b1);
+
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+	ConstantBuffer<Material> material = ResourceDescriptorHeap[BindlessIndicesCB.MaterialIndex];
+	return input.Colour * material.Tint;
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../Application.h"
 #include "../Globals/Helpers.h"
 #include "CommandQueue.h"
+#include "ResourceStateTracker.h"
 
 AppWindow::AppWindow(HWND hWnd, const std::wstring& windowName, UINT clientWidth, UINT clientHeight, bool vsync)
 	: m_hWnd(hWnd)
@@ -121,6 +122,7 @@ void AppWindow::OnResize(UINT width, UINT height)
 
 		for (int i = 0; i < BufferCount; ++i)
 		{
+			ResourceStateTracker::RemoveGlobalResourceState(m_BackBuffers[i].Get());
 			m_BackBuffers[i].Reset();
 		}
 
@@ -149,6 +151,7 @@ void AppWindow::Cleanup()
 	for (int i = 0; i < BufferCount; ++i)
 	{
 		auto resource = m_BackBuffers[i].Get();
+		ResourceStateTracker::RemoveGlobalResourceState(resource);
 		m_BackBuffers[i].Reset();
 	}
 
@@ -306,6 +309,7 @@ void AppWindow::UpdateRenderTargetViews()
 		ThrowIfFailed(m_SwapChain->GetBuffer(i, IID_PPV_ARGS(&backBuffer)));
 
 		device->CreateRenderTargetView(backBuffer.Get(), nullptr, rtvHandle);
+		ResourceStateTracker::AddGlobalResourceState(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
 
 		m_BackBuffers[i] = backBuffer;
 		rtvHandle.Offset(m_RTVDescriptorSize);
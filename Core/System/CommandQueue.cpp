@@ -2,9 +2,25 @@
 #include "../Application.h"
 #include "../Globals/Helpers.h"
 
+#include <vector>
+
+namespace
+{
+	// The queue whose callbacks this thread is running, if any.
+	thread_local const CommandQueue* t_CallbackQueue = nullptr;
+}
+
 CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE type)
 	: m_CommandListType(type)
 	, m_FenceValue(0)
+	, m_NumSubmissions(0)
+	, m_NumCommandLists(0)
+	, m_NumSignals(0)
+	, m_NumWaits(0)
+	, m_NextCallbackBatch(0)
+	, m_RunningCallbackBatch(0)
+	, m_CompletionThreadIdle(false)
+	, m_StopCompletionThread(false)
 {
 	auto device = Application::Get().GetDevice();
 
@@ -15,14 +31,26 @@ CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE type)
 	desc.NodeMask = 0;
 
 	ThrowIfFailed(device->CreateCommandQueue(&desc, IID_PPV_ARGS(&m_CommandQueue)));
-	ThrowIfFailed(device->CreateFence(m_FenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence)));
+	ThrowIfFailed(device->CreateFence(m_FenceValue.load(), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence)));
 
-	m_FenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-	assert(m_FenceEvent && "Failed to create fence event");
+	m_CompletionEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_WakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	assert(m_CompletionEvent && m_WakeEvent && "Failed to create completion thread events");
+
+	m_CompletionThread = std::thread(&CommandQueue::CompletionThread, this);
 }
 
 CommandQueue::~CommandQueue()
 {
+	m_StopCompletionThread = true;
+	::SetEvent(m_WakeEvent);
+	m_CompletionThread.join();
+
+	// Callbacks whose fences never completed are dropped.
+	ProcessCompletedFences();
+
+	::CloseHandle(m_WakeEvent);
+	::CloseHandle(m_CompletionEvent);
 }
 
 ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList()
@@ -30,23 +58,34 @@ ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList()
 	ComPtr<ID3D12CommandAllocator> commandAllocator;
 	ComPtr<ID3D12GraphicsCommandList2> commandList;
 
-	if (!m_CommandAllocatorQueue.empty() && IsFenceComplete(m_CommandAllocatorQueue.front().fenceValue))
 	{
-		commandAllocator = m_CommandAllocatorQueue.front().commandAllocator;
-		m_CommandAllocatorQueue.pop();
+		std::lock_guard<std::mutex> lock(m_CommandListMutex);
+
+		m_ResetAllocators.ConsumeAll([this](ComPtr<ID3D12CommandAllocator>&& allocator)
+			{
+				m_AvailableAllocators.push_back(std::move(allocator));
+			});
 
-		ThrowIfFailed(commandAllocator->Reset());
+		if (!m_AvailableAllocators.empty())
+		{
+			commandAllocator = std::move(m_AvailableAllocators.back());
+			m_AvailableAllocators.pop_back();
+		}
+
+		if (!m_CommandListQueue.empty())
+		{
+			commandList = m_CommandListQueue.front();
+			m_CommandListQueue.pop();
+		}
 	}
-	else
+
+	if (!commandAllocator)
 	{
 		commandAllocator = CreateCommandAllocator();
 	}
 
-	if (!m_CommandListQueue.empty())
+	if (commandList)
 	{
-		commandList = m_CommandListQueue.front();
-		m_CommandListQueue.pop();
-
 		ThrowIfFailed(commandList->Reset(commandAllocator.Get(), nullptr));
 	}
 	else
@@ -66,31 +105,112 @@ ComPtr<ID3D12CommandQueue> CommandQueue::GetCommandQueue() const
 
 uint64_t CommandQueue::ExecuteCommandList(ComPtr<ID3D12GraphicsCommandList2> commandList)
 {
-	commandList->Close();
+	const ComPtr<ID3D12GraphicsCommandList2> commandLists[] = { commandList };
+	return ExecuteCommandLists(commandLists, 1);
+}
 
-	ID3D12CommandAllocator* commandAllocator;
-	UINT dataSize = sizeof(commandAllocator);
-	ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+uint64_t CommandQueue::ExecuteCommandLists(const ComPtr<ID3D12GraphicsCommandList2>* commandLists, size_t numCommandLists)
+{
+	std::vector<ID3D12CommandList*> lists(numCommandLists);
+	std::vector<ID3D12CommandAllocator*> commandAllocators(numCommandLists);
 
-	ID3D12CommandList* const commandLists[] = {
-			commandList.Get()
-	};
+	for (size_t i = 0; i < numCommandLists; ++i)
+	{
+		commandLists[i]->Close();
 
-	m_CommandQueue->ExecuteCommandLists(1, commandLists);
+		UINT dataSize = sizeof(commandAllocators[i]);
+		ThrowIfFailed(commandLists[i]->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocators[i]));
 
-	uint64_t fenceValue = Signal();
+		lists[i] = commandLists[i].Get();
+	}
+
+	uint64_t fenceValue = Submit(lists.data(), static_cast<UINT>(numCommandLists));
+
+	std::vector<ComPtr<ID3D12CommandAllocator>> submittedAllocators;
+	submittedAllocators.reserve(numCommandLists);
+
+	{
+		std::lock_guard<std::mutex> lock(m_CommandListMutex);
+
+		for (size_t i = 0; i < numCommandLists; ++i)
+		{
+			submittedAllocators.emplace_back(commandAllocators[i]);
+			m_CommandListQueue.push(commandLists[i]);
+
+			commandAllocators[i]->Release();
+		}
+	}
 
-	m_CommandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocator });
-	m_CommandListQueue.push(commandList);
+	OnFenceComplete(fenceValue, [this, allocators = std::move(submittedAllocators)]()
+		{
+			for (auto& allocator : allocators)
+			{
+				if (SUCCEEDED(allocator->Reset()))
+				{
+					m_ResetAllocators.Push(allocator);
+				}
+			}
+		});
 
-	commandAllocator->Release();
 	return fenceValue;
 }
 
+uint64_t CommandQueue::ExecuteCommandLists(const ComPtr<ID3D12GraphicsCommandList2>* commandLists,
+	ResourceStateTracker* const* stateTrackers, size_t numCommandLists)
+{
+	std::vector<ComPtr<ID3D12GraphicsCommandList2>> lists;
+	lists.reserve(numCommandLists * 2);
+
+	auto lock = ResourceStateTracker::LockGlobalStates();
+
+	for (size_t i = 0; i < numCommandLists; ++i)
+	{
+		ResourceStateTracker* stateTracker = stateTrackers[i];
+		stateTracker->FlushResourceBarriers(commandLists[i].Get());
+
+		// Only take a list once the pending transitions are known to need
+		// barriers.
+		if (stateTracker->ResolvePendingResourceBarriers() > 0)
+		{
+			auto pendingCommandList = GetCommandList();
+			stateTracker->FlushPendingResourceBarriers(pendingCommandList.Get());
+			lists.push_back(pendingCommandList);
+		}
+
+		stateTracker->CommitFinalResourceStates();
+		stateTracker->Reset();
+
+		lists.push_back(commandLists[i]);
+	}
+
+	// Submitted under the lock so the next submission resolves against
+	// states this one leaves behind.
+	return ExecuteCommandLists(lists.data(), lists.size());
+}
+
+uint64_t CommandQueue::Submit(ID3D12CommandList* const* commandLists, UINT numCommandLists)
+{
+	std::lock_guard<std::mutex> lock(m_SubmitMutex);
+
+	m_CommandQueue->ExecuteCommandLists(numCommandLists, commandLists);
+
+	++m_NumSubmissions;
+	m_NumCommandLists += numCommandLists;
+
+	return SignalLocked();
+}
+
 uint64_t CommandQueue::Signal()
+{
+	std::lock_guard<std::mutex> lock(m_SubmitMutex);
+	return SignalLocked();
+}
+
+uint64_t CommandQueue::SignalLocked()
 {
 	uint64_t fenceValueForSignal = ++m_FenceValue;
 	ThrowIfFailed(m_CommandQueue->Signal(m_Fence.Get(), fenceValueForSignal));
+	++m_NumSignals;
 	return fenceValueForSignal;
 }
 
@@ -103,9 +223,12 @@ void CommandQueue::WaitForFenceValue(uint64_t fenceValue)
 {
 	if (!IsFenceComplete(fenceValue))
 	{
-		m_Fence->SetEventOnCompletion(fenceValue, m_FenceEvent);
-		::WaitForSingleObject(m_FenceEvent, DWORD_MAX);
+		// A null event blocks this thread alone until the fence is reached, so
+		// any number of threads can wait at once.
+		ThrowIfFailed(m_Fence->SetEventOnCompletion(fenceValue, nullptr));
 	}
+
+	ProcessCompletedFences();
 }
 
 void CommandQueue::Flush()
@@ -113,6 +236,191 @@ void CommandQueue::Flush()
 	WaitForFenceValue(Signal());
 }
 
+void CommandQueue::Wait(const CommandQueue& other, uint64_t fenceValue)
+{
+	if (&other == this || other.GetCompletedFenceValue() >= fenceValue)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_WaitMutex);
+
+	auto waited = std::find_if(m_WaitedFenceValues.begin(), m_WaitedFenceValues.end(),
+		[&other](const std::pair<const CommandQueue*, uint64_t>& entry) { return entry.first == &other; });
+
+	if (waited == m_WaitedFenceValues.end())
+	{
+		waited = m_WaitedFenceValues.insert(waited, { &other, 0 });
+	}
+	else if (waited->second >= fenceValue)
+	{
+		return;
+	}
+
+	ThrowIfFailed(m_CommandQueue->Wait(other.m_Fence.Get(), fenceValue));
+
+	waited->second = fenceValue;
+	++m_NumWaits;
+}
+
+void CommandQueue::OnFenceComplete(uint64_t fenceValue, std::function<void()> callback)
+{
+	m_QueuedCallbacks.Push(FenceCallback{ fenceValue, std::move(callback) });
+
+	// Sequentially consistent with the push, pairing with the idle store and
+	// empty check in CompletionThread.
+	if (m_CompletionThreadIdle.load(std::memory_order_seq_cst))
+	{
+		::SetEvent(m_WakeEvent);
+	}
+}
+
+void CommandQueue::ReleaseAfterQueues(const std::shared_ptr<CommandQueue>* queues, size_t numQueues, std::function<void()> release)
+{
+	struct PendingRelease
+	{
+		std::function<void()> Release;
+		std::atomic<uint32_t> PendingQueues;
+
+		void QueueCompleted()
+		{
+			if (PendingQueues.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				Release();
+			}
+		}
+	};
+
+	auto pendingRelease = std::make_shared<PendingRelease>();
+	pendingRelease->Release = std::move(release);
+
+	// Hold one reference ourselves so a queue completing mid-loop can't run
+	// the release before every queue has been tagged.
+	pendingRelease->PendingQueues = 1;
+
+	for (size_t i = 0; i < numQueues; ++i)
+	{
+		uint64_t fenceValue = queues[i]->GetLastSignalledFenceValue();
+
+		if (!queues[i]->IsFenceComplete(fenceValue))
+		{
+			pendingRelease->PendingQueues.fetch_add(1, std::memory_order_relaxed);
+			queues[i]->ReleaseAfterFence(fenceValue, [pendingRelease]() { pendingRelease->QueueCompleted(); });
+		}
+	}
+
+	pendingRelease->QueueCompleted();
+}
+
+void CommandQueue::ProcessCompletedFences()
+{
+	RunCompletedCallbacks();
+}
+
+uint64_t CommandQueue::RunCompletedCallbacks()
+{
+	std::vector<std::function<void()>> batch;
+	uint64_t batchSequence;
+	uint64_t nextFenceValue;
+
+	// A callback's batch holds the turn the nested call would wait for.
+	assert(t_CallbackQueue != this && "Callbacks must not wait on or process their own queue");
+
+	{
+		std::lock_guard<std::mutex> lock(m_CallbackMutex);
+
+		m_QueuedCallbacks.ConsumeAll([this](FenceCallback&& callback)
+			{
+				m_PendingCallbacks.push(std::move(callback));
+			});
+
+		uint64_t completedValue = m_Fence->GetCompletedValue();
+		while (!m_PendingCallbacks.empty() && m_PendingCallbacks.front().fenceValue <= completedValue)
+		{
+			batch.push_back(std::move(m_PendingCallbacks.front().callback));
+			m_PendingCallbacks.pop();
+		}
+
+		// Even an empty batch takes a turn, so callers only return once
+		// batches taken before theirs have finished.
+		batchSequence = m_NextCallbackBatch++;
+		nextFenceValue = m_PendingCallbacks.empty() ? 0 : m_PendingCallbacks.front().fenceValue;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_CallbackMutex);
+		m_CallbackBatchDone.wait(lock, [this, batchSequence] { return m_RunningCallbackBatch == batchSequence; });
+	}
+
+	const CommandQueue* outerCallbackQueue = t_CallbackQueue;
+	t_CallbackQueue = this;
+
+	for (auto& callback : batch)
+	{
+		callback();
+	}
+
+	t_CallbackQueue = outerCallbackQueue;
+
+	{
+		std::lock_guard<std::mutex> lock(m_CallbackMutex);
+		++m_RunningCallbackBatch;
+	}
+
+	m_CallbackBatchDone.notify_all();
+
+	return nextFenceValue;
+}
+
+void CommandQueue::CompletionThread()
+{
+	const HANDLE Handles[] = { m_CompletionEvent, m_WakeEvent };
+
+	while (!m_StopCompletionThread)
+	{
+		uint64_t nextFenceValue = RunCompletedCallbacks();
+
+		if (nextFenceValue != 0)
+		{
+			if (SUCCEEDED(m_Fence->SetEventOnCompletion(nextFenceValue, m_CompletionEvent)))
+			{
+				::WaitForMultipleObjects(_countof(Handles), Handles, FALSE, INFINITE);
+			}
+
+			continue;
+		}
+
+		// Re-check after going idle so a callback queued in between isn't
+		// left waiting for a wake-up that was never sent.
+		m_CompletionThreadIdle.store(true, std::memory_order_seq_cst);
+		if (m_QueuedCallbacks.IsEmpty() && !m_StopCompletionThread)
+		{
+			::WaitForSingleObject(m_WakeEvent, INFINITE);
+		}
+
+		m_CompletionThreadIdle.store(false, std::memory_order_relaxed);
+	}
+}
+
+CommandQueue::Statistics CommandQueue::GetStatistics() const
+{
+	Statistics stats;
+	stats.NumSubmissions = m_NumSubmissions;
+	stats.NumCommandLists = m_NumCommandLists;
+	stats.NumSignals = m_NumSignals;
+	stats.NumWaits = m_NumWaits;
+
+	return stats;
+}
+
+void CommandQueue::ResetStatistics()
+{
+	m_NumSubmissions = 0;
+	m_NumCommandLists = 0;
+	m_NumSignals = 0;
+	m_NumWaits = 0;
+}
+
 ComPtr<ID3D12CommandAllocator> CommandQueue::CreateCommandAllocator()
 {
 	auto device = Application::Get().GetDevice();
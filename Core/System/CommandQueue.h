@@ -1,5 +1,16 @@
 #pragma once
 #include "../Globals/stdafx.h"
+#include "MPSCQueue.h"
+#include "ResourceStateTracker.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 class CommandQueue
 {
@@ -9,36 +20,127 @@ public:
 
 	ComPtr<ID3D12GraphicsCommandList2> GetCommandList();
 	ComPtr<ID3D12CommandQueue> GetCommandQueue() const;
+	D3D12_COMMAND_LIST_TYPE GetCommandListType() const { return m_CommandListType; }
 
 	uint64_t ExecuteCommandList(ComPtr<ID3D12GraphicsCommandList2> commandList);
 
+	// Closes the lists and submits them in order with one ExecuteCommandLists
+	// call and one fence signal. Each list and its allocator are recycled as
+	// with ExecuteCommandList.
+	uint64_t ExecuteCommandLists(const ComPtr<ID3D12GraphicsCommandList2>* commandLists, size_t numCommandLists);
+
+	// As above, but first resolves each list's tracked first-use transitions
+	// against the global resource states, recording the barriers still needed
+	// into a list submitted just before it, and commits its final states.
+	uint64_t ExecuteCommandLists(const ComPtr<ID3D12GraphicsCommandList2>* commandLists,
+		ResourceStateTracker* const* stateTrackers, size_t numCommandLists);
+
+	// Submits closed lists whose allocators the caller recycles itself.
+	uint64_t Submit(ID3D12CommandList* const* commandLists, UINT numCommandLists);
+
 	uint64_t Signal();
 	bool IsFenceComplete(uint64_t fenceValue);
 	void WaitForFenceValue(uint64_t fenceValue);
 	void Flush();
 
+	// Makes work submitted to this queue from now on wait on the GPU until
+	// other's fence reaches fenceValue. Skipped if the fence has already
+	// passed or an earlier wait on other covers it. Safe to call from several
+	// threads.
+	void Wait(const CommandQueue& other, uint64_t fenceValue);
+
+	uint64_t GetLastSignalledFenceValue() const { return m_FenceValue; }
+	uint64_t GetCompletedFenceValue() const { return m_Fence->GetCompletedValue(); }
+
+	// Runs callback once the fence reaches fenceValue, in the order callbacks
+	// were queued. The queue's completion thread runs them as the fence
+	// progresses, so they must be safe to call from another thread. A
+	// callback must not call WaitForFenceValue, Flush or
+	// ProcessCompletedFences on its own queue, which would deadlock. Queuing
+	// never takes a lock.
+	void OnFenceComplete(uint64_t fenceValue, std::function<void()> callback);
+	void ReleaseAfterFence(uint64_t fenceValue, std::function<void()> release) { OnFenceComplete(fenceValue, std::move(release)); }
+
+	// Runs release once every one of queues has completed the work submitted
+	// to it so far, or straight away if they all have.
+	static void ReleaseAfterQueues(const std::shared_ptr<CommandQueue>* queues, size_t numQueues, std::function<void()> release);
+
+	// Runs completed callbacks on the calling thread. WaitForFenceValue calls
+	// this, so callbacks up to the awaited fence have run when it returns.
+	void ProcessCompletedFences();
+
+	struct Statistics
+	{
+		uint64_t NumSubmissions;
+		uint64_t NumCommandLists;
+		uint64_t NumSignals;
+		uint64_t NumWaits;
+	};
+
+	// Counts since construction or the last ResetStatistics.
+	Statistics GetStatistics() const;
+	void ResetStatistics();
+
 protected:
 	ComPtr<ID3D12CommandAllocator> CreateCommandAllocator();
 	ComPtr<ID3D12GraphicsCommandList2> CreateCommandList(ComPtr<ID3D12CommandAllocator> allocator);
 
 private:
-
-	struct CommandAllocatorEntry
+	struct FenceCallback
 	{
 		uint64_t fenceValue;
-		ComPtr<ID3D12CommandAllocator> commandAllocator;
+		std::function<void()> callback;
 	};
 
-	typedef std::queue<CommandAllocatorEntry> CommandAllocatorQueue;
 	typedef std::queue<ComPtr<ID3D12GraphicsCommandList2>> CommandListQueue;
 
+	// Runs completed callbacks and returns the fence value the oldest
+	// remaining one waits for, or 0 if there are none. Ready callbacks are
+	// taken as a batch under m_CallbackMutex and run after it is released;
+	// batches run one at a time in the order they were taken.
+	uint64_t RunCompletedCallbacks();
+	void CompletionThread();
+
+	// Fence values are handed out and signalled under m_SubmitMutex, so the
+	// queue sees them in increasing order.
+	uint64_t SignalLocked();
+
 	D3D12_COMMAND_LIST_TYPE m_CommandListType;
 	ComPtr<ID3D12CommandQueue> m_CommandQueue;
 	ComPtr<ID3D12Fence> m_Fence;
-	HANDLE m_FenceEvent;
-	uint64_t m_FenceValue;
+	std::atomic<uint64_t> m_FenceValue;
+	std::mutex m_SubmitMutex;
+
+	std::atomic<uint64_t> m_NumSubmissions;
+	std::atomic<uint64_t> m_NumCommandLists;
+	std::atomic<uint64_t> m_NumSignals;
+	std::atomic<uint64_t> m_NumWaits;
+
+	// Highest fence value already waited on, per other queue.
+	std::vector<std::pair<const CommandQueue*, uint64_t>> m_WaitedFenceValues;
+	std::mutex m_WaitMutex;
 
-	CommandAllocatorQueue m_CommandAllocatorQueue;
+	// Allocators are reset on the completion thread once their fence passes
+	// and handed back through m_ResetAllocators. The pools below and the
+	// m_ResetAllocators consumer are guarded by m_CommandListMutex, so lists
+	// can be taken and submitted from any thread.
+	MPSCQueue<ComPtr<ID3D12CommandAllocator>> m_ResetAllocators;
+	std::vector<ComPtr<ID3D12CommandAllocator>> m_AvailableAllocators;
 	CommandListQueue m_CommandListQueue;
+	std::mutex m_CommandListMutex;
+
+	MPSCQueue<FenceCallback> m_QueuedCallbacks;
+	// Only touched with m_CallbackMutex held, which producers never take.
+	std::queue<FenceCallback> m_PendingCallbacks;
+	uint64_t m_NextCallbackBatch;
+	uint64_t m_RunningCallbackBatch;
+	std::condition_variable m_CallbackBatchDone;
+	std::mutex m_CallbackMutex;
+
+	std::thread m_CompletionThread;
+	HANDLE m_CompletionEvent;
+	HANDLE m_WakeEvent;
+	std::atomic<bool> m_CompletionThreadIdle;
+	std::atomic<bool> m_StopCompletionThread;
 };
 
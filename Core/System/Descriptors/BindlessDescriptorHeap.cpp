@@ -0,0 +1,128 @@
+#include "BindlessDescriptorHeap.h"
+#include "../CommandQueue.h"
+#include "../../Application.h"
+#include "../../Globals/Helpers.h"
+
+#include <new>
+
+BindlessDescriptorHeap::BindlessDescriptorHeap(uint32_t numDescriptors)
+	: m_NumDescriptors(numDescriptors)
+	, m_NumFreeIndices(numDescriptors)
+	, m_NumPendingReleases(0)
+	, m_FreeIndices(numDescriptors)
+{
+	auto& app = Application::Get();
+
+	m_DescriptorHeap = app.CreateDescriptorHeap(m_NumDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+	m_BaseCPUDescriptor = m_DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+	m_BaseGPUDescriptor = m_DescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+	m_DescriptorHandleIncrementSize = app.GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+BindlessDescriptorHeap::~BindlessDescriptorHeap()
+{
+}
+
+uint32_t BindlessDescriptorHeap::RegisterShaderResourceView(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* srvDesc)
+{
+	uint32_t index = AllocateIndex();
+	Application::Get().GetDevice()->CreateShaderResourceView(resource, srvDesc, GetCPUDescriptorHandle(index));
+	return index;
+}
+
+uint32_t BindlessDescriptorHeap::RegisterUnorderedAccessView(ID3D12Resource* resource, ID3D12Resource* counterResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* uavDesc)
+{
+	uint32_t index = AllocateIndex();
+	Application::Get().GetDevice()->CreateUnorderedAccessView(resource, counterResource, uavDesc, GetCPUDescriptorHandle(index));
+	return index;
+}
+
+uint32_t BindlessDescriptorHeap::RegisterConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC* cbvDesc)
+{
+	uint32_t index = AllocateIndex();
+	Application::Get().GetDevice()->CreateConstantBufferView(cbvDesc, GetCPUDescriptorHandle(index));
+	return index;
+}
+
+uint32_t BindlessDescriptorHeap::RegisterDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptor)
+{
+	uint32_t index = AllocateIndex();
+	Application::Get().GetDevice()->CopyDescriptorsSimple(1, GetCPUDescriptorHandle(index), srcDescriptor, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	return index;
+}
+
+void BindlessDescriptorHeap::Release(uint32_t index)
+{
+	Release(&index, 1);
+}
+
+void BindlessDescriptorHeap::Release(const uint32_t* indices, size_t numIndices)
+{
+	std::vector<uint32_t> releasedIndices;
+	releasedIndices.reserve(numIndices);
+
+	for (size_t i = 0; i < numIndices; ++i)
+	{
+		if (indices[i] != InvalidIndex)
+		{
+			assert(indices[i] < m_NumDescriptors);
+			releasedIndices.push_back(indices[i]);
+		}
+	}
+
+	if (releasedIndices.empty())
+	{
+		return;
+	}
+
+	auto& app = Application::Get();
+	const std::shared_ptr<CommandQueue> queues[] =
+	{
+		app.GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT),
+		app.GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE),
+		app.GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY)
+	};
+
+	m_NumPendingReleases += releasedIndices.size();
+
+	auto heap = shared_from_this();
+	CommandQueue::ReleaseAfterQueues(queues, _countof(queues),
+		[heap, releasedIndices = std::move(releasedIndices)]() { heap->RecycleIndices(releasedIndices); });
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessDescriptorHeap::GetCPUDescriptorHandle(uint32_t index) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_BaseCPUDescriptor, index, m_DescriptorHandleIncrementSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE BindlessDescriptorHeap::GetGPUDescriptorHandle(uint32_t index) const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_BaseGPUDescriptor, index, m_DescriptorHandleIncrementSize);
+}
+
+uint32_t BindlessDescriptorHeap::AllocateIndex()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t index = m_FreeIndices.Allocate(1);
+	if (index == TLSFFreeList::InvalidOffset)
+	{
+		throw std::bad_alloc();
+	}
+
+	--m_NumFreeIndices;
+	return index;
+}
+
+void BindlessDescriptorHeap::RecycleIndices(const std::vector<uint32_t>& indices)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (uint32_t index : indices)
+	{
+		m_FreeIndices.Free(index, 1);
+	}
+
+	m_NumFreeIndices += static_cast<uint32_t>(indices.size());
+	m_NumPendingReleases -= indices.size();
+}
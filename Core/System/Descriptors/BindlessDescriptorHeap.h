@@ -0,0 +1,54 @@
+#pragma once
+#include "../TLSFFreeList.h"
+#include "../../Globals/stdafx.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One large shader-visible CBV/SRV/UAV heap handing out stable indices that
+// shaders use to index ResourceDescriptorHeap directly. Released indices are
+// only recycled once every queue has finished the work submitted before the
+// release. Pending releases keep the heap alive, so it is always owned by a
+// shared_ptr.
+class BindlessDescriptorHeap : public std::enable_shared_from_this<BindlessDescriptorHeap>
+{
+public:
+	static constexpr uint32_t InvalidIndex = TLSFFreeList::InvalidOffset;
+
+	explicit BindlessDescriptorHeap(uint32_t numDescriptors = 65536);
+	virtual ~BindlessDescriptorHeap();
+
+	uint32_t RegisterShaderResourceView(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* srvDesc);
+	uint32_t RegisterUnorderedAccessView(ID3D12Resource* resource, ID3D12Resource* counterResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* uavDesc);
+	uint32_t RegisterConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC* cbvDesc);
+	uint32_t RegisterDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptor);
+
+	void Release(uint32_t index);
+	void Release(const uint32_t* indices, size_t numIndices);
+
+	ID3D12DescriptorHeap* GetDescriptorHeap() const { return m_DescriptorHeap.Get(); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(uint32_t index) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandle(uint32_t index) const;
+
+	uint32_t GetNumDescriptors() const { return m_NumDescriptors; }
+	uint32_t GetNumFreeIndices() const { return m_NumFreeIndices; }
+	size_t GetNumPendingReleases() const { return m_NumPendingReleases; }
+
+private:
+	uint32_t AllocateIndex();
+	void RecycleIndices(const std::vector<uint32_t>& indices);
+
+	ComPtr<ID3D12DescriptorHeap> m_DescriptorHeap;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE m_BaseCPUDescriptor;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE m_BaseGPUDescriptor;
+	uint32_t m_DescriptorHandleIncrementSize;
+	uint32_t m_NumDescriptors;
+	std::atomic<uint32_t> m_NumFreeIndices;
+	std::atomic<size_t> m_NumPendingReleases;
+
+	TLSFFreeList m_FreeIndices;
+	std::mutex m_Mutex;
+};
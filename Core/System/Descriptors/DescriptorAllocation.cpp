@@ -1,6 +1,6 @@
 #include "DescriptorAllocation.h"
 #include "DescriptorAllocatorPage.h"
-#include "../../Application.h"
+#include "ThreadDescriptorCache.h"
 
 #include "../../Globals/stdafx.h"
 #include "../../Globals/Helpers.h"
@@ -63,7 +63,13 @@ void DescriptorAllocation::Free()
 {
 	if (!IsNull() && m_Page)
 	{
-		m_Page->Free(std::move(*this), Application::GetFrameCount());
+		if (m_NumHandles == 1)
+		{
+			ThreadDescriptorCache::Free(std::move(*this));
+			return;
+		}
+
+		m_Page->Free(std::move(*this));
 
 		m_Descriptor.ptr = 0;
 		m_NumHandles = 0;
@@ -27,6 +27,9 @@ public:
 	std::shared_ptr<DescriptorAllocatorPage> GetDescriptorAllocationPage() const { return m_Page; }
 
 private:
+	friend class ThreadDescriptorCache;
+	friend class DescriptorAllocator;
+
 	void Free();
 
 	D3D12_CPU_DESCRIPTOR_HANDLE m_Descriptor;
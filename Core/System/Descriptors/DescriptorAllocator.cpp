@@ -1,11 +1,35 @@
 #include "DescriptorAllocator.h"
 #include "DescriptorAllocatorPage.h"
+#include "ThreadDescriptorCache.h"
 #include "../../Globals/stdafx.h"
 #include "../../Globals/Helpers.h"
 
+#include <atomic>
+#include <intrin.h>
+#include <new>
+
+static std::atomic<uint64_t> s_NextAllocatorId{ 1 };
+
+static uint32_t FloorLog2(uint32_t value)
+{
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return static_cast<uint32_t>(index);
+}
+
+static uint32_t LowestSetBit(uint32_t value)
+{
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return static_cast<uint32_t>(index);
+}
+
 DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptorsPerHeap)
 	: m_HeapType(type)
+	, m_AllocatorId(s_NextAllocatorId.fetch_add(1, std::memory_order_relaxed))
 	, m_NumDescriptorsPerHeap(numDescriptorsPerHeap)
+	, m_SizeClassMask(0)
+	, m_DirtyPages(std::make_shared<DirtyPageList>())
 {
 }
 
@@ -15,54 +39,418 @@ DescriptorAllocator::~DescriptorAllocator()
 
 DescriptorAllocation DescriptorAllocator::Allocate(uint32_t numDescriptors)
 {
+	if (numDescriptors == 1)
+	{
+		return ThreadDescriptorCache::Allocate(*this);
+	}
+
+	return AllocateFromHeaps(numDescriptors);
+}
+
+std::vector<DescriptorAllocation> DescriptorAllocator::AllocateBatch(const uint32_t* counts, size_t numRanges)
+{
+	std::vector<DescriptorAllocation> allocations(numRanges);
+
+	uint64_t totalDescriptors = 0;
+	for (size_t i = 0; i < numRanges; ++i)
+	{
+		totalDescriptors += counts[i];
+	}
+
+	if (totalDescriptors == 0)
+	{
+		return allocations;
+	}
+
 	std::lock_guard<std::mutex> lock(m_AllocationMutex);
 
-	DescriptorAllocation alloc;
-	for (auto iter = m_AvailableHeaps.begin(); iter != m_AvailableHeaps.end(); ++iter)
+	// Prefer one contiguous block in an existing page, then the ranges one by
+	// one in existing pages, and only then a block in a new page.
+	DescriptorAllocation block;
+	if (totalDescriptors <= m_NumDescriptorsPerHeap)
+	{
+		block = TryAllocateFromPagesLocked(static_cast<uint32_t>(totalDescriptors));
+	}
+
+	if (block.IsNull())
 	{
-		auto allocatorPage = m_HeapPool[*iter];
-		alloc = allocatorPage->Allocate(numDescriptors);
-		if (allocatorPage->NumFreeHandles() == 0)
+		uint64_t numPlaced = AllocateRangesFromPagesLocked(counts, numRanges, allocations.data());
+		if (numPlaced == totalDescriptors)
 		{
-			iter = m_AvailableHeaps.erase(iter);
+			return allocations;
 		}
 
-		if (!alloc.IsNull())
+		if (numPlaced == 0 && totalDescriptors <= m_NumDescriptorsPerHeap)
 		{
-			break;
+			block = AllocateFromHeapsLocked(static_cast<uint32_t>(totalDescriptors));
+		}
+	}
+
+	if (!block.IsNull())
+	{
+		// The page frees any sub-range on its own, so the block can be handed
+		// out as independent allocations.
+		uint32_t offset = 0;
+		for (size_t i = 0; i < numRanges; ++i)
+		{
+			if (counts[i] > 0)
+			{
+				allocations[i] = DescriptorAllocation(block.GetDescriptorHandle(offset), counts[i], block.m_DescriptorSize, block.m_Page);
+				offset += counts[i];
+			}
 		}
+
+		block.m_Descriptor.ptr = 0;
+		block.m_NumHandles = 0;
+		block.m_DescriptorSize = 0;
+
+		return allocations;
 	}
 
+	for (size_t i = 0; i < numRanges; ++i)
+	{
+		if (counts[i] > 0 && allocations[i].IsNull())
+		{
+			allocations[i] = AllocateFromHeapsLocked(counts[i]);
+		}
+	}
+
+	return allocations;
+}
+
+uint64_t DescriptorAllocator::AllocateRangesFromPagesLocked(const uint32_t* counts, size_t numRanges, DescriptorAllocation* allocations)
+{
+	uint64_t numPlaced = 0;
+	for (size_t i = 0; i < numRanges; ++i)
+	{
+		if (counts[i] > 0)
+		{
+			allocations[i] = TryAllocateFromPagesLocked(counts[i]);
+			if (allocations[i].IsNull())
+			{
+				break;
+			}
+
+			numPlaced += counts[i];
+		}
+	}
+
+	return numPlaced;
+}
+
+void DescriptorAllocator::FreeBatch(DescriptorAllocation* allocations, size_t numAllocations)
+{
+	std::vector<DescriptorAllocation*> pending;
+	pending.reserve(numAllocations);
+
+	for (size_t i = 0; i < numAllocations; ++i)
+	{
+		if (!allocations[i].IsNull() && allocations[i].m_Page)
+		{
+			pending.push_back(&allocations[i]);
+		}
+	}
+
+	std::stable_sort(pending.begin(), pending.end(),
+		[](const DescriptorAllocation* a, const DescriptorAllocation* b) { return a->m_Page.get() < b->m_Page.get(); });
+
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> handles;
+	std::vector<uint32_t> numHandles;
+
+	for (size_t first = 0; first < pending.size();)
+	{
+		auto page = pending[first]->m_Page;
+
+		handles.clear();
+		numHandles.clear();
+
+		size_t last = first;
+		while (last < pending.size() && pending[last]->m_Page == page)
+		{
+			handles.push_back(pending[last]->m_Descriptor);
+			numHandles.push_back(pending[last]->m_NumHandles);
+
+			pending[last]->m_Descriptor.ptr = 0;
+			pending[last]->m_NumHandles = 0;
+			pending[last]->m_DescriptorSize = 0;
+			pending[last]->m_Page.reset();
+			++last;
+		}
+
+		page->Free(handles.data(), numHandles.data(), handles.size());
+		first = last;
+	}
+}
+
+DescriptorAllocation DescriptorAllocator::AllocateFromHeaps(uint32_t numDescriptors)
+{
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+	return AllocateFromHeapsLocked(numDescriptors);
+}
+
+DescriptorAllocation DescriptorAllocator::AllocateFromHeapsLocked(uint32_t numDescriptors)
+{
+	DescriptorAllocation alloc = TryAllocateFromPagesLocked(numDescriptors);
+	if (!alloc.IsNull())
+	{
+		return alloc;
+	}
+
+	m_NumDescriptorsPerHeap = std::max(m_NumDescriptorsPerHeap, numDescriptors);
+	auto newPage = CreateAllocatorPage();
+
+	alloc = newPage->Allocate(numDescriptors);
+	UpdatePageIndex(newPage->GetPoolIndex());
+
 	if (alloc.IsNull())
 	{
-		m_NumDescriptorsPerHeap = std::max(m_NumDescriptorsPerHeap, numDescriptors);
-		auto newPage = CreateAllocatorPage();
-		alloc = newPage->Allocate(numDescriptors);
+		throw std::bad_alloc();
 	}
 
 	return alloc;
 }
 
-void DescriptorAllocator::ReleaseStaleDescriptors(uint64_t frameNumber)
+DescriptorAllocation DescriptorAllocator::TryAllocateFromPagesLocked(uint32_t numDescriptors)
+{
+	size_t pageIndex = FindAvailablePage(numDescriptors);
+	if (pageIndex == InvalidPageIndex)
+	{
+		RefreshDirtyPages();
+		pageIndex = FindAvailablePage(numDescriptors);
+	}
+
+	if (pageIndex == InvalidPageIndex)
+	{
+		return DescriptorAllocation();
+	}
+
+	// A stale index entry is corrected here and the caller falls back to a new
+	// page.
+	DescriptorAllocation alloc = m_HeapPool[pageIndex]->Allocate(numDescriptors);
+	UpdatePageIndex(pageIndex);
+
+	return alloc;
+}
+
+DescriptorAllocator::Statistics DescriptorAllocator::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+
+	Statistics stats = { m_HeapType, m_HeapPool.size(), 0, 0, 0 };
+	for (const auto& page : m_HeapPool)
+	{
+		stats.NumDescriptors += page->GetNumDescriptors();
+		stats.NumFreeHandles += page->NumFreeHandles();
+		stats.LargestFreeBlock = std::max(stats.LargestFreeBlock, page->LargestFreeBlock());
+	}
+
+	return stats;
+}
+
+size_t DescriptorAllocator::TrimIdlePages(std::chrono::steady_clock::duration idleTime, size_t minPages)
+{
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+
+	// Allocations only happen under the allocator lock, so a page found idle
+	// here stays idle until it is dropped from the pool.
+	DescriptorHeapPool keptPages;
+	keptPages.reserve(m_HeapPool.size());
+
+	size_t numRemovable = m_HeapPool.size() > minPages ? m_HeapPool.size() - minPages : 0;
+	size_t numTrimmed = 0;
+
+	for (auto& page : m_HeapPool)
+	{
+		if (numTrimmed < numRemovable && page->IsIdleFor(idleTime))
+		{
+			++numTrimmed;
+			continue;
+		}
+
+		keptPages.push_back(std::move(page));
+	}
+
+	if (numTrimmed > 0)
+	{
+		m_HeapPool = std::move(keptPages);
+		RebuildPageIndex();
+	}
+
+	return numTrimmed;
+}
+
+size_t DescriptorAllocator::BeginCompaction(float maxOccupancy)
 {
 	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+
+	std::vector<size_t> candidates;
+	uint64_t freeInTargets = 0;
+
 	for (size_t i = 0; i < m_HeapPool.size(); ++i)
 	{
-		auto page = m_HeapPool[i];
-		page->ReleaseStaleDescriptors(frameNumber);
+		const auto& page = m_HeapPool[i];
+		uint32_t usedHandles = page->GetNumDescriptors() - page->NumFreeHandles();
 
-		if (page->NumFreeHandles() > 0)
+		if (usedHandles > 0 && usedHandles <= maxOccupancy * page->GetNumDescriptors() && !page->HasCachedRanges())
 		{
-			m_AvailableHeaps.insert(i);
+			candidates.push_back(i);
 		}
+
+		freeInTargets += page->NumFreeHandles();
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+	{
+		return m_HeapPool[a]->NumFreeHandles() > m_HeapPool[b]->NumFreeHandles();
+	});
+
+	// Drain the emptiest pages first and stop once the remaining pages can no
+	// longer take their descriptors.
+	uint64_t usedInDraining = 0;
+	size_t numDraining = 0;
+
+	for (size_t pageIndex : candidates)
+	{
+		const auto& page = m_HeapPool[pageIndex];
+		uint32_t usedHandles = page->GetNumDescriptors() - page->NumFreeHandles();
+
+		if (usedInDraining + usedHandles > freeInTargets - page->NumFreeHandles())
+		{
+			break;
+		}
+
+		freeInTargets -= page->NumFreeHandles();
+		usedInDraining += usedHandles;
+		page->SetDraining(true);
+		UpdatePageIndex(pageIndex);
+		++numDraining;
+	}
+
+	return numDraining;
+}
+
+void DescriptorAllocator::EndCompaction()
+{
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+
+	for (size_t i = 0; i < m_HeapPool.size(); ++i)
+	{
+		if (m_HeapPool[i]->IsDraining())
+		{
+			m_HeapPool[i]->SetDraining(false);
+			UpdatePageIndex(i);
+		}
+	}
+}
+
+void DescriptorAllocator::RebuildPageIndex()
+{
+	for (auto& bucket : m_SizeClassBuckets)
+	{
+		bucket.clear();
+	}
+
+	m_SizeClassMask = 0;
+	m_PageIndex.assign(m_HeapPool.size(), PageIndexEntry());
+
+	for (size_t i = 0; i < m_HeapPool.size(); ++i)
+	{
+		m_HeapPool[i]->SetPoolIndex(i);
+		UpdatePageIndex(i);
 	}
 }
 
 std::shared_ptr<DescriptorAllocatorPage> DescriptorAllocator::CreateAllocatorPage()
 {
-	auto newPage = std::make_shared<DescriptorAllocatorPage>(m_HeapType, m_NumDescriptorsPerHeap);
+	auto newPage = std::make_shared<DescriptorAllocatorPage>(m_HeapType, m_NumDescriptorsPerHeap, m_DirtyPages);
 
+	newPage->SetPoolIndex(m_HeapPool.size());
 	m_HeapPool.emplace_back(newPage);
-	m_AvailableHeaps.insert(m_HeapPool.size() - 1);
+	m_PageIndex.emplace_back();
+	UpdatePageIndex(m_HeapPool.size() - 1);
 	return newPage;
 }
+
+size_t DescriptorAllocator::FindAvailablePage(uint32_t numDescriptors) const
+{
+	if (numDescriptors == 0)
+	{
+		return InvalidPageIndex;
+	}
+
+	// Any page in a class above floor(log2(n)) is guaranteed to fit, unless n is
+	// an exact power of two, in which case its own class fits as well.
+	uint32_t sizeClass = FloorLog2(numDescriptors);
+	uint32_t guaranteedClass = (numDescriptors & (numDescriptors - 1)) == 0 ? sizeClass : sizeClass + 1;
+
+	if (guaranteedClass < NumSizeClasses)
+	{
+		uint32_t candidates = m_SizeClassMask & (~0u << guaranteedClass);
+		if (candidates != 0)
+		{
+			return m_SizeClassBuckets[LowestSetBit(candidates)].back();
+		}
+	}
+
+	if (guaranteedClass != sizeClass)
+	{
+		for (size_t pageIndex : m_SizeClassBuckets[sizeClass])
+		{
+			if (m_PageIndex[pageIndex].LargestFreeBlock >= numDescriptors)
+			{
+				return pageIndex;
+			}
+		}
+	}
+
+	return InvalidPageIndex;
+}
+
+void DescriptorAllocator::UpdatePageIndex(size_t pageIndex)
+{
+	auto& entry = m_PageIndex[pageIndex];
+	uint32_t largestFreeBlock = m_HeapPool[pageIndex]->LargestFreeBlock();
+	uint32_t sizeClass = largestFreeBlock > 0 && !m_HeapPool[pageIndex]->IsDraining() ? FloorLog2(largestFreeBlock) : InvalidSizeClass;
+
+	entry.LargestFreeBlock = largestFreeBlock;
+	if (sizeClass == entry.SizeClass)
+	{
+		return;
+	}
+
+	if (entry.SizeClass != InvalidSizeClass)
+	{
+		auto& bucket = m_SizeClassBuckets[entry.SizeClass];
+		size_t movedPage = bucket.back();
+		bucket[entry.BucketSlot] = movedPage;
+		m_PageIndex[movedPage].BucketSlot = entry.BucketSlot;
+		bucket.pop_back();
+
+		if (bucket.empty())
+		{
+			m_SizeClassMask &= ~(1u << entry.SizeClass);
+		}
+	}
+
+	entry.SizeClass = sizeClass;
+	if (sizeClass != InvalidSizeClass)
+	{
+		auto& bucket = m_SizeClassBuckets[sizeClass];
+		entry.BucketSlot = bucket.size();
+		bucket.push_back(pageIndex);
+		m_SizeClassMask |= 1u << sizeClass;
+	}
+}
+
+void DescriptorAllocator::RefreshDirtyPages()
+{
+	for (const auto& page : m_DirtyPages->TakeAll())
+	{
+		// Trimmed pages may still be queued; their slot now holds another page.
+		size_t pageIndex = page->GetPoolIndex();
+		if (page->ConsumeIndexDirty() && pageIndex < m_HeapPool.size() && m_HeapPool[pageIndex] == page)
+		{
+			UpdatePageIndex(pageIndex);
+		}
+	}
+}
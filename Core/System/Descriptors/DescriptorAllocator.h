@@ -1,13 +1,14 @@
 #pragma once
 #include "../../Globals/d3dx12.h"
 #include "DescriptorAllocation.h"
+#include <chrono>
 #include <cstdint>
 #include <mutex>
 #include <memory>
-#include <set>
 #include <vector>
 
 class DescriptorAllocatorPage;
+class DirtyPageList;
 
 class DescriptorAllocator
 {
@@ -17,17 +18,90 @@ public:
 
 	DescriptorAllocation Allocate(uint32_t numDescriptors = 1);
 
-	void ReleaseStaleDescriptors(uint64_t frameNumber);
+	// Allocates one range per entry of counts under a single lock. The ranges
+	// are carved from one contiguous block when an existing page has room for
+	// the whole batch, then placed one by one in existing pages, and only then
+	// is a new page created. Zero counts yield null allocations.
+	std::vector<DescriptorAllocation> AllocateBatch(const uint32_t* counts, size_t numRanges);
+
+	// Frees the allocations with one stale-descriptor retirement per page and
+	// leaves them null.
+	void FreeBatch(DescriptorAllocation* allocations, size_t numAllocations);
+
+	D3D12_DESCRIPTOR_HEAP_TYPE GetHeapType() const { return m_HeapType; }
+	uint64_t GetAllocatorId() const { return m_AllocatorId; }
+
+	struct Statistics
+	{
+		D3D12_DESCRIPTOR_HEAP_TYPE HeapType;
+		size_t NumPages;
+		uint64_t NumDescriptors;
+		uint64_t NumFreeHandles;
+		uint32_t LargestFreeBlock;
+	};
+
+	Statistics GetStatistics();
+
+	// Releases pages that have been completely free for at least idleTime,
+	// keeping minPages around to absorb the next allocation. Returns the
+	// number of pages released.
+	size_t TrimIdlePages(std::chrono::steady_clock::duration idleTime, size_t minPages = 1);
 
 private:
+	friend class ThreadDescriptorCache;
+	friend class DescriptorIndirectionTable;
+
+	// Marks the least occupied pages at or below maxOccupancy as draining, as
+	// long as their live descriptors fit in the free space of the rest. Pages
+	// a thread cache still holds a range of are skipped. Returns the number of
+	// pages marked.
+	size_t BeginCompaction(float maxOccupancy);
+	void EndCompaction();
+	void RebuildPageIndex();
+
+	DescriptorAllocation AllocateFromHeaps(uint32_t numDescriptors);
+	DescriptorAllocation AllocateFromHeapsLocked(uint32_t numDescriptors);
+
+	// Like AllocateFromHeapsLocked, but returns a null allocation instead of
+	// creating a page.
+	DescriptorAllocation TryAllocateFromPagesLocked(uint32_t numDescriptors);
+
+	// Places ranges in existing pages until one doesn't fit. Returns the number
+	// of descriptors placed; the placed ranges are left in allocations.
+	uint64_t AllocateRangesFromPagesLocked(const uint32_t* counts, size_t numRanges, DescriptorAllocation* allocations);
+
 	using DescriptorHeapPool = std::vector<std::shared_ptr<DescriptorAllocatorPage>>;
 	std::shared_ptr<DescriptorAllocatorPage> CreateAllocatorPage();
 
+	// Pages are bucketed by floor(log2(largest free block)) so a request can go
+	// straight to a page that fits without probing fragmented ones.
+	static constexpr uint32_t NumSizeClasses = 32;
+	static constexpr uint32_t InvalidSizeClass = ~0u;
+	static constexpr size_t InvalidPageIndex = ~size_t(0);
+
+	struct PageIndexEntry
+	{
+		uint32_t SizeClass = InvalidSizeClass;
+		uint32_t LargestFreeBlock = 0;
+		size_t BucketSlot = 0;
+	};
+
+	size_t FindAvailablePage(uint32_t numDescriptors) const;
+	void UpdatePageIndex(size_t pageIndex);
+
+	// Re-indexes only the pages that queued themselves since the last refresh.
+	void RefreshDirtyPages();
+
 	D3D12_DESCRIPTOR_HEAP_TYPE m_HeapType;
+	uint64_t m_AllocatorId;
 	uint32_t m_NumDescriptorsPerHeap;
 	DescriptorHeapPool m_HeapPool;
 
-	std::set<size_t> m_AvailableHeaps;
+	std::vector<PageIndexEntry> m_PageIndex;
+	std::vector<size_t> m_SizeClassBuckets[NumSizeClasses];
+	uint32_t m_SizeClassMask;
+	std::shared_ptr<DirtyPageList> m_DirtyPages;
+
 	std::mutex m_AllocationMutex;
 };
 
@@ -1,12 +1,35 @@
 #include "DescriptorAllocatorPage.h"
 #include "../../Application.h"
+#include "../CommandQueue.h"
 #include "../../Globals/stdafx.h"
 #include "../../Globals/d3dx12.h"
 #include "../../Globals/Helpers.h"
 
-DescriptorAllocatorPage::DescriptorAllocatorPage(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors)
+void DirtyPageList::Push(std::shared_ptr<DescriptorAllocatorPage> page)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Pages.push_back(std::move(page));
+}
+
+std::vector<std::shared_ptr<DescriptorAllocatorPage>> DirtyPageList::TakeAll()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	std::vector<std::shared_ptr<DescriptorAllocatorPage>> pages;
+	pages.swap(m_Pages);
+	return pages;
+}
+
+DescriptorAllocatorPage::DescriptorAllocatorPage(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors,
+	std::shared_ptr<DirtyPageList> dirtyPages)
 	: m_HeapType(type)
 	, m_NumDescriptorsInHeap(numDescriptors)
+	, m_FreeList(numDescriptors)
+	, m_IdleSince(std::chrono::steady_clock::now())
+	, m_DirtyPages(std::move(dirtyPages))
+	, m_PoolIndex(0)
+	, m_IndexDirty(false)
+	, m_Draining(false)
+	, m_NumCachedRanges(0)
 {
 	auto device = Application::Get().GetDevice();
 
@@ -17,9 +40,7 @@ DescriptorAllocatorPage::DescriptorAllocatorPage(D3D12_DESCRIPTOR_HEAP_TYPE type
 	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_DescriptorHeap)));
 	m_BaseDescriptor = m_DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
 	m_DescriptorHandleIncrementSize = device->GetDescriptorHandleIncrementSize(m_HeapType);
-	m_NumFreeHandles = m_NumDescriptorsInHeap;
-
-	AddNewBlock(0, m_NumFreeHandles);
+	m_NumFreeHandles.store(m_NumDescriptorsInHeap, std::memory_order_relaxed);
 }
 
 D3D12_DESCRIPTOR_HEAP_TYPE DescriptorAllocatorPage::GetHeapType() const
@@ -27,124 +48,138 @@ D3D12_DESCRIPTOR_HEAP_TYPE DescriptorAllocatorPage::GetHeapType() const
 	return m_HeapType;
 }
 
-bool DescriptorAllocatorPage::HasSpace(uint32_t numDescriptors) const
+bool DescriptorAllocatorPage::HasSpace(uint32_t numDescriptors)
 {
-	return m_FreeListBySize.lower_bound(numDescriptors) != m_FreeListBySize.end();
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+	return m_FreeList.HasSpace(numDescriptors);
 }
 
 uint32_t DescriptorAllocatorPage::NumFreeHandles() const
 {
-	return m_NumFreeHandles;
+	return m_NumFreeHandles.load(std::memory_order_relaxed);
+}
+
+uint32_t DescriptorAllocatorPage::LargestFreeBlock()
+{
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+	return m_FreeList.LargestFreeBlock();
+}
+
+bool DescriptorAllocatorPage::IsIdleFor(std::chrono::steady_clock::duration idleTime)
+{
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+	return m_NumFreeHandles.load(std::memory_order_relaxed) == m_NumDescriptorsInHeap &&
+		std::chrono::steady_clock::now() - m_IdleSince >= idleTime;
 }
 
 DescriptorAllocation DescriptorAllocatorPage::Allocate(uint32_t numDescriptors)
 {
 	std::lock_guard<std::mutex> lock(m_AllocationMutex);
 
-	if (numDescriptors > m_NumFreeHandles)
+	if (numDescriptors > m_NumFreeHandles.load(std::memory_order_relaxed))
 	{
 		return DescriptorAllocation();
 	}
 
-	auto smallestBlockIt = m_FreeListBySize.lower_bound(numDescriptors);
-	if (smallestBlockIt == m_FreeListBySize.end())
+	auto offset = m_FreeList.Allocate(numDescriptors);
+	if (offset == TLSFFreeList::InvalidOffset)
 	{
 		return DescriptorAllocation();
 	}
 
-	auto blockSize = smallestBlockIt->first;
-	auto offsetIt = smallestBlockIt->second;
-	auto offset = offsetIt->first;
-
-	m_FreeListBySize.erase(smallestBlockIt);
-	m_FreeListByOffset.erase(offsetIt);
-
-	auto newOffset = offset + numDescriptors;
-	auto newSize = blockSize - numDescriptors;
-	
-	if (newSize > 0)
-	{
-		AddNewBlock(newOffset, newSize);
-	}
-
-	m_NumFreeHandles -= numDescriptors;
+	m_NumFreeHandles.fetch_sub(numDescriptors, std::memory_order_relaxed);
 
 	return DescriptorAllocation(
 		CD3DX12_CPU_DESCRIPTOR_HANDLE(m_BaseDescriptor, offset, m_DescriptorHandleIncrementSize),
 		numDescriptors, m_DescriptorHandleIncrementSize, shared_from_this());
 }
 
-void DescriptorAllocatorPage::Free(DescriptorAllocation&& descriptorHandle, uint64_t frameNumber)
+void DescriptorAllocatorPage::Free(DescriptorAllocation&& descriptorHandle)
 {
 	auto offset = ComputeOffset(descriptorHandle.GetDescriptorHandle());
-
-	std::lock_guard<std::mutex> lock(m_AllocationMutex);
-	m_StaleDescriptors.emplace(offset, descriptorHandle.GetNumHandles(), frameNumber);
+	RetireStaleDescriptors({ { offset, descriptorHandle.GetNumHandles() } });
 }
 
-void DescriptorAllocatorPage::ReleaseStaleDescriptors(uint64_t frameNumber)
+void DescriptorAllocatorPage::Free(const D3D12_CPU_DESCRIPTOR_HANDLE* handles, size_t numHandles)
 {
-	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+	std::vector<StaleDescriptorInfo> staleDescriptors;
+	staleDescriptors.reserve(numHandles);
 
-	while (!m_StaleDescriptors.empty() && m_StaleDescriptors.front().FrameNumber <= frameNumber)
+	for (size_t i = 0; i < numHandles; ++i)
 	{
-		auto& staleDescriptor = m_StaleDescriptors.front();
+		staleDescriptors.push_back({ ComputeOffset(handles[i]), 1 });
+	}
 
-		auto offset = staleDescriptor.Offset;
-		auto numDescriptors = staleDescriptor.Size;
+	RetireStaleDescriptors(std::move(staleDescriptors));
+}
 
-		FreeBlock(offset, numDescriptors);
+void DescriptorAllocatorPage::Free(const D3D12_CPU_DESCRIPTOR_HANDLE* handles, const uint32_t* numDescriptors, size_t numRanges)
+{
+	std::vector<StaleDescriptorInfo> staleDescriptors;
+	staleDescriptors.reserve(numRanges);
 
-		m_StaleDescriptors.pop();
+	for (size_t i = 0; i < numRanges; ++i)
+	{
+		staleDescriptors.push_back({ ComputeOffset(handles[i]), numDescriptors[i] });
 	}
+
+	RetireStaleDescriptors(std::move(staleDescriptors));
 }
 
-uint32_t DescriptorAllocatorPage::ComputeOffset(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+void DescriptorAllocatorPage::ReturnUnused(D3D12_CPU_DESCRIPTOR_HANDLE handle, uint32_t numDescriptors)
 {
-	return static_cast<uint32_t>(handle.ptr - m_BaseDescriptor.ptr) / m_DescriptorHandleIncrementSize;
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
+	FreeBlock(ComputeOffset(handle), numDescriptors);
+	MarkIndexDirty();
 }
 
-void DescriptorAllocatorPage::AddNewBlock(uint32_t offset, uint32_t numDescriptors)
+void DescriptorAllocatorPage::RetireStaleDescriptors(std::vector<StaleDescriptorInfo>&& staleDescriptors)
 {
-	auto offsetIt = m_FreeListByOffset.emplace(offset, numDescriptors);
-	auto sizeIt = m_FreeListBySize.emplace(numDescriptors, offsetIt.first);
-	offsetIt.first->second.FreeListBySizeIt = sizeIt;
+	auto& app = Application::Get();
+	const std::shared_ptr<CommandQueue> queues[] =
+	{
+		app.GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT),
+		app.GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE),
+		app.GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY)
+	};
+
+	auto page = shared_from_this();
+	CommandQueue::ReleaseAfterQueues(queues, _countof(queues),
+		[page, staleDescriptors = std::move(staleDescriptors)]() { page->ReleaseStaleDescriptors(staleDescriptors); });
 }
 
-void DescriptorAllocatorPage::FreeBlock(uint32_t offset, uint32_t numDescriptors)
+void DescriptorAllocatorPage::ReleaseStaleDescriptors(const std::vector<StaleDescriptorInfo>& staleDescriptors)
 {
-	auto nextBlockIt = m_FreeListByOffset.upper_bound(offset);
-	auto prevBlockIt = nextBlockIt;
+	std::lock_guard<std::mutex> lock(m_AllocationMutex);
 
-	if (prevBlockIt != m_FreeListByOffset.begin())
-	{
-		--prevBlockIt;
-	}
-	else
+	for (const auto& staleDescriptor : staleDescriptors)
 	{
-		prevBlockIt = m_FreeListByOffset.end();
+		FreeBlock(staleDescriptor.Offset, staleDescriptor.Size);
 	}
 
-	m_NumFreeHandles += numDescriptors;
+	MarkIndexDirty();
+}
 
-	if (prevBlockIt != m_FreeListByOffset.end() &&
-		offset == prevBlockIt->first + prevBlockIt->second.Size)
-	{
-		offset = prevBlockIt->first;
-		numDescriptors += prevBlockIt->second.Size;
+uint32_t DescriptorAllocatorPage::ComputeOffset(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+	return static_cast<uint32_t>(handle.ptr - m_BaseDescriptor.ptr) / m_DescriptorHandleIncrementSize;
+}
 
-		m_FreeListBySize.erase(prevBlockIt->second.FreeListBySizeIt);
-		m_FreeListByOffset.erase(prevBlockIt);
-	}
+void DescriptorAllocatorPage::FreeBlock(uint32_t offset, uint32_t numDescriptors)
+{
+	uint32_t numFreeHandles = m_NumFreeHandles.fetch_add(numDescriptors, std::memory_order_relaxed) + numDescriptors;
+	m_FreeList.Free(offset, numDescriptors);
 
-	if (nextBlockIt != m_FreeListByOffset.end() &&
-		offset + numDescriptors == nextBlockIt->first)
+	if (numFreeHandles == m_NumDescriptorsInHeap)
 	{
-		numDescriptors += nextBlockIt->second.Size;
-
-		m_FreeListBySize.erase(nextBlockIt->second.FreeListBySizeIt);
-		m_FreeListByOffset.erase(nextBlockIt);
+		m_IdleSince = std::chrono::steady_clock::now();
 	}
+}
 
-	AddNewBlock(offset, numDescriptors);
+void DescriptorAllocatorPage::MarkIndexDirty()
+{
+	if (!m_IndexDirty.exchange(true, std::memory_order_acq_rel) && m_DirtyPages)
+	{
+		m_DirtyPages->Push(shared_from_this());
+	}
 }
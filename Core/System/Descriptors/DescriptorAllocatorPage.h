@@ -1,79 +1,113 @@
 #pragma once
 #include "DescriptorAllocation.h"
+#include "../TLSFFreeList.h"
 #include "../../Globals/d3dx12.h"
 
 #include <d3d12.h>
 #include <wrl.h>
-#include <map>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <vector>
+
+class DescriptorAllocatorPage;
+
+// Pages whose free space grew outside of the owning allocator queue
+// themselves here, so the allocator re-indexes only those.
+class DirtyPageList
+{
+public:
+	void Push(std::shared_ptr<DescriptorAllocatorPage> page);
+	std::vector<std::shared_ptr<DescriptorAllocatorPage>> TakeAll();
+
+private:
+	std::vector<std::shared_ptr<DescriptorAllocatorPage>> m_Pages;
+	std::mutex m_Mutex;
+};
 
 class DescriptorAllocatorPage : public std::enable_shared_from_this<DescriptorAllocatorPage>
 {
 public:
-	DescriptorAllocatorPage(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors);
+	DescriptorAllocatorPage(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors,
+		std::shared_ptr<DirtyPageList> dirtyPages = nullptr);
 
 	D3D12_DESCRIPTOR_HEAP_TYPE GetHeapType() const;
 
-	bool HasSpace(uint32_t numDescriptors) const;
+	bool HasSpace(uint32_t numDescriptors);
+
+	uint32_t GetNumDescriptors() const { return m_NumDescriptorsInHeap; }
 
+	// Changes under the page lock, but may be read without it, e.g. while
+	// the completion thread retires stale descriptors.
 	uint32_t NumFreeHandles() const;
+	uint32_t LargestFreeBlock();
+
+	// True once every descriptor has been free for at least idleTime.
+	bool IsIdleFor(std::chrono::steady_clock::duration idleTime);
+
+	// Draining pages are skipped by the allocator so compaction can empty them.
+	bool IsDraining() const { return m_Draining.load(std::memory_order_acquire); }
+	void SetDraining(bool draining) { m_Draining.store(draining, std::memory_order_release); }
+
+	// Counts thread caches currently carving single descriptors out of a range
+	// of this page. Compaction leaves such pages alone, since those threads
+	// would keep allocating from them.
+	void AcquireCachedRange() { m_NumCachedRanges.fetch_add(1, std::memory_order_relaxed); }
+	void ReleaseCachedRange() { m_NumCachedRanges.fetch_sub(1, std::memory_order_relaxed); }
+	bool HasCachedRanges() const { return m_NumCachedRanges.load(std::memory_order_relaxed) > 0; }
+
+	// Set when free space grows outside of the owning allocator, e.g. when stale
+	// descriptors retire or a thread cache hands back an unused range. The
+	// first change after a consume pushes the page onto the dirty list.
+	bool ConsumeIndexDirty() { return m_IndexDirty.exchange(false, std::memory_order_acquire); }
+
+	// Position in the owning allocator's pool, maintained under its lock.
+	size_t GetPoolIndex() const { return m_PoolIndex; }
+	void SetPoolIndex(size_t poolIndex) { m_PoolIndex = poolIndex; }
 
 	DescriptorAllocation Allocate(uint32_t numDescriptors);
 
-	void Free(DescriptorAllocation&& descriptorHandle, uint64_t frameNumber);
-	void ReleaseStaleDescriptors(uint64_t frameNumber);
+	// Freed descriptors stay reserved until every queue has completed the work
+	// that was submitted before the free.
+	void Free(DescriptorAllocation&& descriptorHandle);
+	void Free(const D3D12_CPU_DESCRIPTOR_HANDLE* handles, size_t numHandles);
+	void Free(const D3D12_CPU_DESCRIPTOR_HANDLE* handles, const uint32_t* numDescriptors, size_t numRanges);
+	void ReturnUnused(D3D12_CPU_DESCRIPTOR_HANDLE handle, uint32_t numDescriptors);
 
 protected:
 	uint32_t ComputeOffset(D3D12_CPU_DESCRIPTOR_HANDLE handle);
-	void AddNewBlock(uint32_t offset, uint32_t numDescriptors);
 	void FreeBlock(uint32_t offset, uint32_t numDescriptors);
+	void MarkIndexDirty();
 
 private:
 	using OffsetType = uint32_t;
 	using SizeType = uint32_t;
 
-	struct FreeBlockInfo;
-	using FreeListByOffset = std::map<OffsetType, FreeBlockInfo>;
-	using FreeListBySize = std::multimap<SizeType, FreeListByOffset::iterator>;
-
-	struct FreeBlockInfo
-	{
-		FreeBlockInfo(SizeType size)
-			: Size(size)
-		{}
-
-		SizeType Size;
-		FreeListBySize::iterator FreeListBySizeIt;
-	};
-
 	struct StaleDescriptorInfo
 	{
-		StaleDescriptorInfo(OffsetType offset, SizeType size, uint64_t frame)
-			: Offset(offset)
-			, Size(size)
-			, FrameNumber(frame)
-		{}
-
 		OffsetType Offset;
 		SizeType Size;
-		uint64_t FrameNumber;
 	};
 
-	using StaleDescriptorQueue = std::queue<StaleDescriptorInfo>;
+	void RetireStaleDescriptors(std::vector<StaleDescriptorInfo>&& staleDescriptors);
+	void ReleaseStaleDescriptors(const std::vector<StaleDescriptorInfo>& staleDescriptors);
 
-	FreeListByOffset m_FreeListByOffset;
-	FreeListBySize m_FreeListBySize;
-	StaleDescriptorQueue m_StaleDescriptors;
+	TLSFFreeList m_FreeList;
 
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_DescriptorHeap;
 	D3D12_DESCRIPTOR_HEAP_TYPE m_HeapType;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE m_BaseDescriptor;
 	uint32_t m_DescriptorHandleIncrementSize;
 	uint32_t m_NumDescriptorsInHeap;
-	uint32_t m_NumFreeHandles;
-
+	std::atomic<uint32_t> m_NumFreeHandles;
+	std::chrono::steady_clock::time_point m_IdleSince;
+
+	std::shared_ptr<DirtyPageList> m_DirtyPages;
+	size_t m_PoolIndex;
+	std::atomic<bool> m_IndexDirty;
+	std::atomic<bool> m_Draining;
+	std::atomic<uint32_t> m_NumCachedRanges;
 	std::mutex m_AllocationMutex;
 };
 
@@ -0,0 +1,100 @@
+#include "DescriptorIndirectionTable.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorAllocatorPage.h"
+#include "ThreadDescriptorCache.h"
+#include "../../Application.h"
+
+DescriptorIndirectionTable::DescriptorIndirectionTable(DescriptorAllocator& allocator)
+	: m_Allocator(allocator)
+{
+}
+
+DescriptorIndirectionTable::~DescriptorIndirectionTable()
+{
+}
+
+uint32_t DescriptorIndirectionTable::Allocate(uint32_t numDescriptors)
+{
+	DescriptorAllocation allocation = m_Allocator.Allocate(numDescriptors);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t slot;
+	if (!m_FreeSlots.empty())
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+		m_Slots[slot] = std::move(allocation);
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(m_Slots.size());
+		m_Slots.push_back(std::move(allocation));
+	}
+
+	return slot;
+}
+
+void DescriptorIndirectionTable::Free(uint32_t slot)
+{
+	if (slot == InvalidSlot)
+	{
+		return;
+	}
+
+	DescriptorAllocation allocation;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		assert(slot < m_Slots.size() && !m_Slots[slot].IsNull());
+
+		allocation = std::move(m_Slots[slot]);
+		m_FreeSlots.push_back(slot);
+	}
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorIndirectionTable::GetDescriptorHandle(uint32_t slot, uint32_t offset) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	assert(slot < m_Slots.size());
+	return m_Slots[slot].GetDescriptorHandle(offset);
+}
+
+uint32_t DescriptorIndirectionTable::Compact(float maxPageOccupancy)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Hand this thread's cached range back first, both so its space counts
+	// towards the targets and so relocations can't be served from a page that
+	// is about to drain.
+	ThreadDescriptorCache::Flush();
+
+	if (m_Allocator.BeginCompaction(maxPageOccupancy) == 0)
+	{
+		return 0;
+	}
+
+	auto device = Application::Get().GetDevice();
+	uint32_t numMoved = 0;
+
+	for (auto& slot : m_Slots)
+	{
+		if (slot.IsNull() || !slot.GetDescriptorAllocationPage()->IsDraining())
+		{
+			continue;
+		}
+
+		DescriptorAllocation relocated = m_Allocator.Allocate(slot.GetNumHandles());
+		device->CopyDescriptorsSimple(slot.GetNumHandles(), relocated.GetDescriptorHandle(), slot.GetDescriptorHandle(), m_Allocator.GetHeapType());
+
+		slot = std::move(relocated);
+		++numMoved;
+	}
+
+	m_Allocator.EndCompaction();
+
+	// Single descriptor frees are batched per thread, so push the old slots
+	// back to their pages now rather than on a later drain.
+	ThreadDescriptorCache::Flush();
+
+	return numMoved;
+}
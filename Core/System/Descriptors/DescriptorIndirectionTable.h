@@ -0,0 +1,41 @@
+#pragma once
+#include "DescriptorAllocation.h"
+
+#include <d3d12.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class DescriptorAllocator;
+
+// Long-lived descriptors referenced through a stable slot instead of a raw
+// handle. Because callers resolve the slot each time they use it, Compact can
+// move the descriptors out of sparsely used pages so they can be trimmed.
+class DescriptorIndirectionTable
+{
+public:
+	static constexpr uint32_t InvalidSlot = ~0u;
+
+	explicit DescriptorIndirectionTable(DescriptorAllocator& allocator);
+	virtual ~DescriptorIndirectionTable();
+
+	uint32_t Allocate(uint32_t numDescriptors = 1);
+	void Free(uint32_t slot);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetDescriptorHandle(uint32_t slot, uint32_t offset = 0) const;
+
+	// Relocates every slot that lives in a page at or below maxPageOccupancy.
+	// Emptied pages are released by a later DescriptorAllocator::TrimIdlePages.
+	// Only the calling thread's descriptor cache is flushed; pages other
+	// threads still cache a range of are not compacted, so have workers call
+	// ThreadDescriptorCache::Flush first. Returns the number of slots moved.
+	uint32_t Compact(float maxPageOccupancy = 0.25f);
+
+private:
+	DescriptorAllocator& m_Allocator;
+
+	std::vector<DescriptorAllocation> m_Slots;
+	std::vector<uint32_t> m_FreeSlots;
+
+	mutable std::mutex m_Mutex;
+};
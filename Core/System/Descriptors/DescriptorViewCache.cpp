@@ -0,0 +1,206 @@
+#include "DescriptorViewCache.h"
+#include "DescriptorAllocator.h"
+#include "../../Application.h"
+
+#include <cstring>
+
+DescriptorViewCache::DescriptorViewCache(DescriptorAllocator& allocator, size_t maxCachedViews)
+	: m_Allocator(allocator)
+	, m_MaxCachedViews(maxCachedViews)
+	, m_Hits(0)
+	, m_Misses(0)
+	, m_Evictions(0)
+{
+	assert(m_Allocator.GetHeapType() == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+DescriptorViewCache::~DescriptorViewCache()
+{
+}
+
+std::shared_ptr<DescriptorAllocation> DescriptorViewCache::GetShaderResourceView(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* srvDesc)
+{
+	ViewKey key = MakeKey(ViewType::ShaderResource, resource, nullptr, srvDesc, sizeof(*srvDesc));
+
+	return FindOrCreate(key, [&](D3D12_CPU_DESCRIPTOR_HANDLE handle)
+	{
+		Application::Get().GetDevice()->CreateShaderResourceView(resource, srvDesc, handle);
+	});
+}
+
+std::shared_ptr<DescriptorAllocation> DescriptorViewCache::GetUnorderedAccessView(ID3D12Resource* resource, ID3D12Resource* counterResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* uavDesc)
+{
+	ViewKey key = MakeKey(ViewType::UnorderedAccess, resource, counterResource, uavDesc, sizeof(*uavDesc));
+
+	return FindOrCreate(key, [&](D3D12_CPU_DESCRIPTOR_HANDLE handle)
+	{
+		Application::Get().GetDevice()->CreateUnorderedAccessView(resource, counterResource, uavDesc, handle);
+	});
+}
+
+std::shared_ptr<DescriptorAllocation> DescriptorViewCache::GetConstantBufferView(ID3D12Resource* resource, const D3D12_CONSTANT_BUFFER_VIEW_DESC* cbvDesc)
+{
+	assert(cbvDesc);
+
+	ViewKey key = MakeKey(ViewType::ConstantBuffer, resource, nullptr, cbvDesc, sizeof(*cbvDesc));
+
+	return FindOrCreate(key, [&](D3D12_CPU_DESCRIPTOR_HANDLE handle)
+	{
+		Application::Get().GetDevice()->CreateConstantBufferView(cbvDesc, handle);
+	});
+}
+
+void DescriptorViewCache::EvictResource(ID3D12Resource* resource)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (auto iter = m_Views.begin(); iter != m_Views.end();)
+	{
+		if (iter->first.Resource == resource || iter->first.CounterResource == resource)
+		{
+			iter = EraseLocked(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void DescriptorViewCache::EvictUnused()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	EvictUnusedLocked();
+}
+
+DescriptorViewCache::Statistics DescriptorViewCache::GetStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return { m_Hits, m_Misses, m_Evictions, m_Views.size() };
+}
+
+bool DescriptorViewCache::ViewKey::operator==(const ViewKey& other) const
+{
+	return Type == other.Type &&
+		Resource == other.Resource &&
+		CounterResource == other.CounterResource &&
+		DescSize == other.DescSize &&
+		std::memcmp(Desc, other.Desc, DescSize) == 0;
+}
+
+size_t DescriptorViewCache::ViewKeyHash::operator()(const ViewKey& key) const
+{
+	// FNV-1a over the identity fields followed by the desc bytes.
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	mix(&key.Type, sizeof(key.Type));
+	mix(&key.Resource, sizeof(key.Resource));
+	mix(&key.CounterResource, sizeof(key.CounterResource));
+	mix(key.Desc, key.DescSize);
+
+	return static_cast<size_t>(hash);
+}
+
+DescriptorViewCache::ViewKey DescriptorViewCache::MakeKey(ViewType type, ID3D12Resource* resource, ID3D12Resource* counterResource, const void* desc, size_t descSize)
+{
+	// Zero the whole key so padding never takes part in comparisons. A null
+	// desc (the resource's default view) is keyed with no desc bytes.
+	ViewKey key;
+	std::memset(&key, 0, sizeof(key));
+
+	key.Type = type;
+	key.Resource = resource;
+	key.CounterResource = counterResource;
+
+	if (desc)
+	{
+		assert(descSize <= MaxDescSize);
+		key.DescSize = static_cast<uint32_t>(descSize);
+		std::memcpy(key.Desc, desc, descSize);
+	}
+
+	return key;
+}
+
+std::shared_ptr<DescriptorAllocation> DescriptorViewCache::FindOrCreate(const ViewKey& key, const std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)>& createView)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto iter = m_Views.find(key);
+	if (iter != m_Views.end())
+	{
+		++m_Hits;
+		m_LRU.splice(m_LRU.end(), m_LRU, iter->second.LRUPosition);
+		return iter->second.Allocation;
+	}
+
+	++m_Misses;
+
+	if (m_Views.size() >= m_MaxCachedViews)
+	{
+		EvictLeastRecentlyUsedLocked(m_Views.size() - m_MaxCachedViews + 1);
+	}
+
+	CachedView view;
+	view.Allocation = std::make_shared<DescriptorAllocation>(m_Allocator.Allocate(1));
+
+	// Written under the lock so a racing hit never sees an unwritten descriptor.
+	createView(view.Allocation->GetDescriptorHandle());
+
+	auto inserted = m_Views.emplace(key, std::move(view)).first;
+	inserted->second.LRUPosition = m_LRU.insert(m_LRU.end(), &inserted->first);
+
+	return inserted->second.Allocation;
+}
+
+void DescriptorViewCache::EvictUnusedLocked()
+{
+	for (auto iter = m_Views.begin(); iter != m_Views.end();)
+	{
+		if (iter->second.Allocation.use_count() == 1)
+		{
+			iter = EraseLocked(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void DescriptorViewCache::EvictLeastRecentlyUsedLocked(size_t numViews)
+{
+	// Views still referenced elsewhere count as used and move to the back, so
+	// each one is skipped at most once per pass.
+	for (size_t numChecked = m_LRU.size(); numViews > 0 && numChecked > 0; --numChecked)
+	{
+		auto iter = m_Views.find(*m_LRU.front());
+
+		if (iter->second.Allocation.use_count() == 1)
+		{
+			EraseLocked(iter);
+			--numViews;
+		}
+		else
+		{
+			m_LRU.splice(m_LRU.end(), m_LRU, m_LRU.begin());
+		}
+	}
+}
+
+DescriptorViewCache::ViewMap::iterator DescriptorViewCache::EraseLocked(ViewMap::iterator iter)
+{
+	m_LRU.erase(iter->second.LRUPosition);
+	++m_Evictions;
+
+	return m_Views.erase(iter);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "DescriptorAllocation.h"
+#include "../../Globals/stdafx.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class DescriptorAllocator;
+
+// De-duplicates CBV/SRV/UAV creation. Views are keyed on the resource and the
+// raw bytes of the view desc, and the same ref-counted allocation is handed
+// back for identical requests. Resources are only used as keys and are not
+// referenced by the cache, so call EvictResource before a resource is released.
+class DescriptorViewCache
+{
+public:
+	struct Statistics
+	{
+		uint64_t Hits;
+		uint64_t Misses;
+		uint64_t Evictions;
+		size_t NumCachedViews;
+	};
+
+	// Once the cache holds maxCachedViews entries, each miss evicts the least
+	// recently used view no longer referenced outside the cache.
+	explicit DescriptorViewCache(DescriptorAllocator& allocator, size_t maxCachedViews = 4096);
+	virtual ~DescriptorViewCache();
+
+	std::shared_ptr<DescriptorAllocation> GetShaderResourceView(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* srvDesc = nullptr);
+	std::shared_ptr<DescriptorAllocation> GetUnorderedAccessView(ID3D12Resource* resource, ID3D12Resource* counterResource = nullptr, const D3D12_UNORDERED_ACCESS_VIEW_DESC* uavDesc = nullptr);
+	std::shared_ptr<DescriptorAllocation> GetConstantBufferView(ID3D12Resource* resource, const D3D12_CONSTANT_BUFFER_VIEW_DESC* cbvDesc);
+
+	// Drops every view of the resource. Must be called before the resource is
+	// released, or a new one created at the same address hits a stale view.
+	void EvictResource(ID3D12Resource* resource);
+
+	// Drops every view that is only referenced by the cache.
+	void EvictUnused();
+
+	Statistics GetStatistics() const;
+
+private:
+	enum class ViewType : uint32_t
+	{
+		ShaderResource,
+		UnorderedAccess,
+		ConstantBuffer
+	};
+
+	static constexpr size_t MaxDescSize = std::max({
+		sizeof(D3D12_SHADER_RESOURCE_VIEW_DESC),
+		sizeof(D3D12_UNORDERED_ACCESS_VIEW_DESC),
+		sizeof(D3D12_CONSTANT_BUFFER_VIEW_DESC) });
+
+	struct ViewKey
+	{
+		ViewType Type;
+		ID3D12Resource* Resource;
+		ID3D12Resource* CounterResource;
+		uint32_t DescSize;
+		uint8_t Desc[MaxDescSize];
+
+		bool operator==(const ViewKey& other) const;
+	};
+
+	struct ViewKeyHash
+	{
+		size_t operator()(const ViewKey& key) const;
+	};
+
+	struct CachedView
+	{
+		std::shared_ptr<DescriptorAllocation> Allocation;
+		std::list<const ViewKey*>::iterator LRUPosition;
+	};
+
+	using ViewMap = std::unordered_map<ViewKey, CachedView, ViewKeyHash>;
+
+	static ViewKey MakeKey(ViewType type, ID3D12Resource* resource, ID3D12Resource* counterResource, const void* desc, size_t descSize);
+
+	// Returns the cached view for the key, or allocates a descriptor and fills
+	// it with createView on a miss.
+	std::shared_ptr<DescriptorAllocation> FindOrCreate(const ViewKey& key, const std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)>& createView);
+	void EvictUnusedLocked();
+	void EvictLeastRecentlyUsedLocked(size_t numViews);
+	ViewMap::iterator EraseLocked(ViewMap::iterator iter);
+
+	DescriptorAllocator& m_Allocator;
+	size_t m_MaxCachedViews;
+
+	ViewMap m_Views;
+
+	// Keys of m_Views, front is least recently used. Map nodes don't move, so
+	// the key pointers stay valid until the entry is erased.
+	std::list<const ViewKey*> m_LRU;
+
+	uint64_t m_Hits;
+	uint64_t m_Misses;
+	uint64_t m_Evictions;
+
+	mutable std::mutex m_Mutex;
+};
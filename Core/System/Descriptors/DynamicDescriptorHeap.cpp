@@ -0,0 +1,304 @@
+#include "DynamicDescriptorHeap.h"
+#include "../CommandQueue.h"
+#include "../../Application.h"
+#include "../../Globals/Helpers.h"
+
+#include <algorithm>
+#include <intrin.h>
+#include <stdexcept>
+
+DynamicDescriptorHeap::DynamicDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptorsPerHeap)
+	: m_DescriptorHeapType(heapType)
+	, m_NumDescriptorsPerHeap(numDescriptorsPerHeap)
+	, m_DescriptorTableBitMask(0)
+	, m_StaleDescriptorTableBitMask(0)
+	, m_CurrentGPUDescriptorHandle(D3D12_GPU_DESCRIPTOR_HANDLE{ 0 })
+	, m_CurrentCPUDescriptorHandle(D3D12_CPU_DESCRIPTOR_HANDLE{ 0 })
+	, m_NumFreeHandles(0)
+	, m_BoundCommandList(nullptr)
+{
+	m_DescriptorHandleIncrementSize = Application::Get().GetDescriptorHandleIncrementSize(heapType);
+	m_DescriptorHandleCache = std::make_unique<D3D12_CPU_DESCRIPTOR_HANDLE[]>(m_NumDescriptorsPerHeap);
+
+	m_SrcRangeStarts.reserve(m_NumDescriptorsPerHeap);
+	m_DstRangeStarts.reserve(m_NumDescriptorsPerHeap);
+	m_RangeSizes.reserve(m_NumDescriptorsPerHeap);
+}
+
+DynamicDescriptorHeap::~DynamicDescriptorHeap()
+{
+}
+
+void DynamicDescriptorHeap::ParseRootSignature(const D3D12_ROOT_SIGNATURE_DESC1& rootSignatureDesc)
+{
+	m_StaleDescriptorTableBitMask = 0;
+	m_DescriptorTableBitMask = 0;
+
+	uint32_t currentOffset = 0;
+	for (uint32_t rootIndex = 0; rootIndex < rootSignatureDesc.NumParameters && rootIndex < MaxDescriptorTables; ++rootIndex)
+	{
+		auto& tableCache = m_DescriptorTableCache[rootIndex];
+		tableCache.Reset();
+
+		const auto& rootParameter = rootSignatureDesc.pParameters[rootIndex];
+		if (rootParameter.ParameterType != D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+		{
+			continue;
+		}
+
+		const auto& table = rootParameter.DescriptorTable;
+		bool isSamplerTable = table.NumDescriptorRanges > 0 &&
+			table.pDescriptorRanges[0].RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+
+		if (isSamplerTable != (m_DescriptorHeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER))
+		{
+			continue;
+		}
+
+		uint32_t numDescriptors = 0;
+		for (UINT i = 0; i < table.NumDescriptorRanges; ++i)
+		{
+			const auto& range = table.pDescriptorRanges[i];
+			if (range.NumDescriptors == UINT_MAX)
+			{
+				numDescriptors = m_NumDescriptorsPerHeap - currentOffset;
+				break;
+			}
+
+			uint32_t rangeStart = range.OffsetInDescriptorsFromTableStart == D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND
+				? numDescriptors : range.OffsetInDescriptorsFromTableStart;
+			numDescriptors = std::max(numDescriptors, rangeStart + range.NumDescriptors);
+		}
+
+		if (currentOffset + numDescriptors > m_NumDescriptorsPerHeap)
+		{
+			throw std::length_error("Root signature requires more than the maximum number of descriptors per descriptor heap.");
+		}
+
+		tableCache.NumDescriptors = numDescriptors;
+		tableCache.BaseDescriptor = m_DescriptorHandleCache.get() + currentOffset;
+
+		// Slots that are never staged stay null and are skipped when copying.
+		std::fill(tableCache.BaseDescriptor, tableCache.BaseDescriptor + numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE{ 0 });
+
+		m_DescriptorTableBitMask |= 1u << rootIndex;
+		currentOffset += numDescriptors;
+	}
+}
+
+void DynamicDescriptorHeap::StageDescriptors(uint32_t rootParameterIndex, uint32_t offset, uint32_t numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptor)
+{
+	if (numDescriptors > m_NumDescriptorsPerHeap || rootParameterIndex >= MaxDescriptorTables)
+	{
+		throw std::bad_alloc();
+	}
+
+	auto& tableCache = m_DescriptorTableCache[rootParameterIndex];
+	if (offset + numDescriptors > tableCache.NumDescriptors)
+	{
+		throw std::length_error("Number of descriptors exceeds the number of descriptors in the descriptor table.");
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE* dstDescriptor = tableCache.BaseDescriptor + offset;
+	for (uint32_t i = 0; i < numDescriptors; ++i)
+	{
+		dstDescriptor[i] = CD3DX12_CPU_DESCRIPTOR_HANDLE(srcDescriptor, i, m_DescriptorHandleIncrementSize);
+	}
+
+	tableCache.NumStagedDescriptors = std::max(tableCache.NumStagedDescriptors, offset + numDescriptors);
+	m_StaleDescriptorTableBitMask |= 1u << rootParameterIndex;
+}
+
+void DynamicDescriptorHeap::CommitStagedDescriptorsForDraw(ID3D12GraphicsCommandList* commandList)
+{
+	CommitStagedDescriptors(commandList, false);
+}
+
+void DynamicDescriptorHeap::CommitStagedDescriptorsForDispatch(ID3D12GraphicsCommandList* commandList)
+{
+	CommitStagedDescriptors(commandList, true);
+}
+
+void DynamicDescriptorHeap::Reset(std::shared_ptr<CommandQueue> commandQueue, uint64_t fenceValue)
+{
+	if (m_CurrentDescriptorHeap)
+	{
+		m_UsedDescriptorHeaps.push_back(m_CurrentDescriptorHeap);
+	}
+
+	for (auto& descriptorHeap : m_UsedDescriptorHeaps)
+	{
+		m_RetiredDescriptorHeaps.push_back({ descriptorHeap, commandQueue, fenceValue });
+	}
+
+	m_UsedDescriptorHeaps.clear();
+	m_CurrentDescriptorHeap.Reset();
+	m_CurrentCPUDescriptorHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(D3D12_CPU_DESCRIPTOR_HANDLE{ 0 });
+	m_CurrentGPUDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_GPU_DESCRIPTOR_HANDLE{ 0 });
+	m_NumFreeHandles = 0;
+	m_BoundCommandList = nullptr;
+
+	m_DescriptorTableBitMask = 0;
+	m_StaleDescriptorTableBitMask = 0;
+
+	for (auto& tableCache : m_DescriptorTableCache)
+	{
+		tableCache.Reset();
+	}
+}
+
+void DynamicDescriptorHeap::CommitStagedDescriptors(ID3D12GraphicsCommandList* commandList, bool isCompute)
+{
+	// A list that has not seen the current heap has none of the tables bound.
+	if (m_BoundCommandList != commandList)
+	{
+		m_StaleDescriptorTableBitMask = m_DescriptorTableBitMask;
+	}
+
+	uint32_t numDescriptorsToCommit = ComputeStaleDescriptorCount();
+	if (numDescriptorsToCommit == 0)
+	{
+		return;
+	}
+
+	if (!m_CurrentDescriptorHeap || m_NumFreeHandles < numDescriptorsToCommit)
+	{
+		if (m_CurrentDescriptorHeap)
+		{
+			m_UsedDescriptorHeaps.push_back(m_CurrentDescriptorHeap);
+		}
+
+		m_CurrentDescriptorHeap = RequestDescriptorHeap();
+		m_CurrentCPUDescriptorHandle = m_CurrentDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+		m_CurrentGPUDescriptorHandle = m_CurrentDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+		m_NumFreeHandles = m_NumDescriptorsPerHeap;
+		m_BoundCommandList = nullptr;
+
+		// Tables bound from the previous heap have to be copied into the new one.
+		m_StaleDescriptorTableBitMask = m_DescriptorTableBitMask;
+		numDescriptorsToCommit = ComputeStaleDescriptorCount();
+	}
+
+	if (m_BoundCommandList != commandList)
+	{
+		ID3D12DescriptorHeap* descriptorHeaps[] = { m_CurrentDescriptorHeap.Get() };
+		commandList->SetDescriptorHeaps(1, descriptorHeaps);
+		m_BoundCommandList = commandList;
+		++m_Statistics.HeapsBound;
+	}
+
+	// Gather every stale table into one CopyDescriptors call, merging source
+	// handles that happen to be contiguous. Unstaged slots are left out, so
+	// each range has its own destination start.
+	m_SrcRangeStarts.clear();
+	m_DstRangeStarts.clear();
+	m_RangeSizes.clear();
+
+	uint32_t numDescriptorsCopied = 0;
+	uint32_t dstOffset = 0;
+
+	uint32_t staleMask = m_StaleDescriptorTableBitMask;
+	while (staleMask != 0)
+	{
+		unsigned long rootIndex;
+		_BitScanForward(&rootIndex, staleMask);
+		staleMask &= staleMask - 1;
+
+		const auto& tableCache = m_DescriptorTableCache[rootIndex];
+		for (uint32_t i = 0; i < tableCache.NumStagedDescriptors; ++i, ++dstOffset)
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE handle = tableCache.BaseDescriptor[i];
+			if (handle.ptr == 0)
+			{
+				continue;
+			}
+
+			CD3DX12_CPU_DESCRIPTOR_HANDLE dstHandle(m_CurrentCPUDescriptorHandle, dstOffset, m_DescriptorHandleIncrementSize);
+			SIZE_T rangeBytes = m_RangeSizes.empty() ? 0 : static_cast<SIZE_T>(m_RangeSizes.back()) * m_DescriptorHandleIncrementSize;
+
+			if (!m_SrcRangeStarts.empty() &&
+				m_SrcRangeStarts.back().ptr + rangeBytes == handle.ptr &&
+				m_DstRangeStarts.back().ptr + rangeBytes == dstHandle.ptr)
+			{
+				++m_RangeSizes.back();
+			}
+			else
+			{
+				m_SrcRangeStarts.push_back(handle);
+				m_DstRangeStarts.push_back(dstHandle);
+				m_RangeSizes.push_back(1);
+			}
+
+			++numDescriptorsCopied;
+		}
+	}
+
+	if (!m_SrcRangeStarts.empty())
+	{
+		auto device = Application::Get().GetDevice();
+
+		UINT numRanges = static_cast<UINT>(m_RangeSizes.size());
+		device->CopyDescriptors(numRanges, m_DstRangeStarts.data(), m_RangeSizes.data(),
+			numRanges, m_SrcRangeStarts.data(), m_RangeSizes.data(), m_DescriptorHeapType);
+
+		++m_Statistics.CopyDescriptorsCalls;
+		m_Statistics.DescriptorsCopied += numDescriptorsCopied;
+	}
+
+	staleMask = m_StaleDescriptorTableBitMask;
+	while (staleMask != 0)
+	{
+		unsigned long rootIndex;
+		_BitScanForward(&rootIndex, staleMask);
+		staleMask &= staleMask - 1;
+
+		if (isCompute)
+		{
+			commandList->SetComputeRootDescriptorTable(rootIndex, m_CurrentGPUDescriptorHandle);
+		}
+		else
+		{
+			commandList->SetGraphicsRootDescriptorTable(rootIndex, m_CurrentGPUDescriptorHandle);
+		}
+
+		uint32_t numDescriptors = m_DescriptorTableCache[rootIndex].NumStagedDescriptors;
+		m_CurrentCPUDescriptorHandle.Offset(numDescriptors, m_DescriptorHandleIncrementSize);
+		m_CurrentGPUDescriptorHandle.Offset(numDescriptors, m_DescriptorHandleIncrementSize);
+		m_NumFreeHandles -= numDescriptors;
+
+		++m_Statistics.TablesCommitted;
+	}
+
+	m_StaleDescriptorTableBitMask = 0;
+}
+
+ComPtr<ID3D12DescriptorHeap> DynamicDescriptorHeap::RequestDescriptorHeap()
+{
+	if (!m_RetiredDescriptorHeaps.empty() &&
+		m_RetiredDescriptorHeaps.front().Queue->IsFenceComplete(m_RetiredDescriptorHeaps.front().FenceValue))
+	{
+		auto descriptorHeap = m_RetiredDescriptorHeaps.front().DescriptorHeap;
+		m_RetiredDescriptorHeaps.pop_front();
+		return descriptorHeap;
+	}
+
+	++m_Statistics.HeapsCreated;
+	return Application::Get().CreateDescriptorHeap(m_NumDescriptorsPerHeap, m_DescriptorHeapType, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+}
+
+uint32_t DynamicDescriptorHeap::ComputeStaleDescriptorCount() const
+{
+	uint32_t numStaleDescriptors = 0;
+
+	uint32_t staleMask = m_StaleDescriptorTableBitMask;
+	while (staleMask != 0)
+	{
+		unsigned long rootIndex;
+		_BitScanForward(&rootIndex, staleMask);
+		staleMask &= staleMask - 1;
+
+		numStaleDescriptors += m_DescriptorTableCache[rootIndex].NumStagedDescriptors;
+	}
+
+	return numStaleDescriptors;
+}
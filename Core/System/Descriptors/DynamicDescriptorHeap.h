@@ -0,0 +1,101 @@
+#pragma once
+#include "../../Globals/stdafx.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class CommandQueue;
+
+// Stages CPU descriptors per root parameter and copies the tables that changed
+// into a shader-visible heap right before a draw or dispatch. One instance is
+// used per command list being recorded; call Reset() once that list has been
+// submitted so its heaps can be recycled after the GPU is done with them.
+class DynamicDescriptorHeap
+{
+public:
+	struct Statistics
+	{
+		uint64_t CopyDescriptorsCalls = 0;
+		uint64_t DescriptorsCopied = 0;
+		uint64_t TablesCommitted = 0;
+		uint64_t HeapsCreated = 0;
+		uint64_t HeapsBound = 0;
+	};
+
+	DynamicDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptorsPerHeap = 1024);
+	virtual ~DynamicDescriptorHeap();
+
+	void ParseRootSignature(const D3D12_ROOT_SIGNATURE_DESC1& rootSignatureDesc);
+
+	void StageDescriptors(uint32_t rootParameterIndex, uint32_t offset, uint32_t numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptor);
+
+	void CommitStagedDescriptorsForDraw(ID3D12GraphicsCommandList* commandList);
+	void CommitStagedDescriptorsForDispatch(ID3D12GraphicsCommandList* commandList);
+
+	void Reset(std::shared_ptr<CommandQueue> commandQueue, uint64_t fenceValue);
+
+	// The current heap is only rebound when committing to a different command
+	// list, and every table is then bound again, so call this after binding
+	// other heaps on the list directly.
+	void InvalidateBoundHeap() { m_BoundCommandList = nullptr; }
+
+	ID3D12DescriptorHeap* GetCurrentDescriptorHeap() const { return m_CurrentDescriptorHeap.Get(); }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	static constexpr uint32_t MaxDescriptorTables = 32;
+
+	struct DescriptorTableCache
+	{
+		void Reset()
+		{
+			NumDescriptors = 0;
+			NumStagedDescriptors = 0;
+			BaseDescriptor = nullptr;
+		}
+
+		uint32_t NumDescriptors = 0;
+		uint32_t NumStagedDescriptors = 0;
+		D3D12_CPU_DESCRIPTOR_HANDLE* BaseDescriptor = nullptr;
+	};
+
+	struct RetiredHeap
+	{
+		ComPtr<ID3D12DescriptorHeap> DescriptorHeap;
+		std::shared_ptr<CommandQueue> Queue;
+		uint64_t FenceValue;
+	};
+
+	void CommitStagedDescriptors(ID3D12GraphicsCommandList* commandList, bool isCompute);
+
+	ComPtr<ID3D12DescriptorHeap> RequestDescriptorHeap();
+	uint32_t ComputeStaleDescriptorCount() const;
+
+	D3D12_DESCRIPTOR_HEAP_TYPE m_DescriptorHeapType;
+	uint32_t m_NumDescriptorsPerHeap;
+	uint32_t m_DescriptorHandleIncrementSize;
+
+	std::unique_ptr<D3D12_CPU_DESCRIPTOR_HANDLE[]> m_DescriptorHandleCache;
+	DescriptorTableCache m_DescriptorTableCache[MaxDescriptorTables];
+
+	uint32_t m_DescriptorTableBitMask;
+	uint32_t m_StaleDescriptorTableBitMask;
+
+	std::vector<ComPtr<ID3D12DescriptorHeap>> m_UsedDescriptorHeaps;
+	std::deque<RetiredHeap> m_RetiredDescriptorHeaps;
+
+	ComPtr<ID3D12DescriptorHeap> m_CurrentDescriptorHeap;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE m_CurrentGPUDescriptorHandle;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE m_CurrentCPUDescriptorHandle;
+	uint32_t m_NumFreeHandles;
+	// The list the current heap was last bound on.
+	ID3D12GraphicsCommandList* m_BoundCommandList;
+
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_SrcRangeStarts;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_DstRangeStarts;
+	std::vector<UINT> m_RangeSizes;
+
+	Statistics m_Statistics;
+};
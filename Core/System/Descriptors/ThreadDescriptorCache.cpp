@@ -0,0 +1,163 @@
+#include "ThreadDescriptorCache.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorAllocatorPage.h"
+
+#include "../../Application.h"
+#include "../../Globals/stdafx.h"
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+	struct CachedRange
+	{
+		uint64_t AllocatorId = 0;
+		std::shared_ptr<DescriptorAllocatorPage> Page;
+		D3D12_CPU_DESCRIPTOR_HANDLE Base = { 0 };
+		uint32_t DescriptorSize = 0;
+		uint32_t NumHandles = 0;
+		uint32_t NextHandle = 0;
+	};
+
+	struct PendingFree
+	{
+		std::shared_ptr<DescriptorAllocatorPage> Page;
+		D3D12_CPU_DESCRIPTOR_HANDLE Handle;
+	};
+
+	struct ThreadCacheState
+	{
+		// Threads that exit without flushing still return what they hold. Once
+		// the application is gone its queues have been flushed, so pending
+		// frees can go straight back to their pages without waiting on a fence.
+		~ThreadCacheState()
+		{
+			for (auto& range : Ranges)
+			{
+				ReturnRange(range);
+			}
+
+			if (Application::IsCreated())
+			{
+				DrainPendingFrees();
+			}
+			else
+			{
+				for (auto& pendingFree : PendingFrees)
+				{
+					pendingFree.Page->ReturnUnused(pendingFree.Handle, 1);
+				}
+
+				PendingFrees.clear();
+			}
+		}
+
+		void ReturnRange(CachedRange& range)
+		{
+			if (!range.Page)
+			{
+				return;
+			}
+
+			if (range.NextHandle < range.NumHandles)
+			{
+				D3D12_CPU_DESCRIPTOR_HANDLE handle = { range.Base.ptr + static_cast<SIZE_T>(range.DescriptorSize) * range.NextHandle };
+				range.Page->ReturnUnused(handle, range.NumHandles - range.NextHandle);
+			}
+
+			range.Page->ReleaseCachedRange();
+			range = CachedRange();
+		}
+
+		void DrainPendingFrees()
+		{
+			if (PendingFrees.empty())
+			{
+				return;
+			}
+
+			std::stable_sort(PendingFrees.begin(), PendingFrees.end(),
+				[](const PendingFree& a, const PendingFree& b) { return a.Page.get() < b.Page.get(); });
+
+			std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> handles;
+			handles.reserve(PendingFrees.size());
+
+			for (size_t first = 0; first < PendingFrees.size();)
+			{
+				auto page = PendingFrees[first].Page.get();
+
+				handles.clear();
+				size_t last = first;
+				while (last < PendingFrees.size() && PendingFrees[last].Page.get() == page)
+				{
+					handles.push_back(PendingFrees[last].Handle);
+					++last;
+				}
+
+				page->Free(handles.data(), handles.size());
+				first = last;
+			}
+
+			PendingFrees.clear();
+		}
+
+		CachedRange Ranges[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+		std::vector<PendingFree> PendingFrees;
+	};
+
+	thread_local ThreadCacheState t_CacheState;
+}
+
+DescriptorAllocation ThreadDescriptorCache::Allocate(DescriptorAllocator& allocator)
+{
+	auto& range = t_CacheState.Ranges[allocator.GetHeapType()];
+
+	if (range.AllocatorId != allocator.GetAllocatorId() || range.NextHandle == range.NumHandles)
+	{
+		t_CacheState.ReturnRange(range);
+
+		DescriptorAllocation batch = allocator.AllocateFromHeaps(RefillBatchSize);
+
+		range.AllocatorId = allocator.GetAllocatorId();
+		range.Page = std::move(batch.m_Page);
+		range.Base = batch.m_Descriptor;
+		range.DescriptorSize = batch.m_DescriptorSize;
+		range.NumHandles = batch.m_NumHandles;
+		range.NextHandle = 0;
+		range.Page->AcquireCachedRange();
+
+		batch.m_Descriptor.ptr = 0;
+		batch.m_NumHandles = 0;
+		batch.m_DescriptorSize = 0;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = { range.Base.ptr + static_cast<SIZE_T>(range.DescriptorSize) * range.NextHandle };
+	++range.NextHandle;
+
+	return DescriptorAllocation(handle, 1, range.DescriptorSize, range.Page);
+}
+
+void ThreadDescriptorCache::Free(DescriptorAllocation&& allocation)
+{
+	t_CacheState.PendingFrees.push_back({ std::move(allocation.m_Page), allocation.m_Descriptor });
+
+	allocation.m_Descriptor.ptr = 0;
+	allocation.m_NumHandles = 0;
+	allocation.m_DescriptorSize = 0;
+
+	if (t_CacheState.PendingFrees.size() >= FreeBatchSize)
+	{
+		t_CacheState.DrainPendingFrees();
+	}
+}
+
+void ThreadDescriptorCache::Flush()
+{
+	for (auto& range : t_CacheState.Ranges)
+	{
+		t_CacheState.ReturnRange(range);
+	}
+
+	t_CacheState.DrainPendingFrees();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "DescriptorAllocation.h"
+
+#include <d3d12.h>
+#include <cstdint>
+
+class DescriptorAllocator;
+
+// Per-thread front end for single descriptor allocations. Each thread keeps a
+// pre-carved range per heap type and a batch of pending frees, so only refills
+// and drains touch the allocator and page locks.
+class ThreadDescriptorCache
+{
+public:
+	static constexpr uint32_t RefillBatchSize = 32;
+	static constexpr uint32_t FreeBatchSize = 64;
+
+	static DescriptorAllocation Allocate(DescriptorAllocator& allocator);
+	static void Free(DescriptorAllocation&& allocation);
+
+	// Returns the calling thread's unused ranges and pending frees to their pages.
+	// Threads that cache descriptors should call this when they finish a batch
+	// of work so the descriptors can be reused; a thread's cache is also
+	// returned when the thread exits.
+	static void Flush();
+};
@@ -0,0 +1,85 @@
+#include "TransientDescriptorRing.h"
+#include "../CommandQueue.h"
+#include "../../Application.h"
+
+#include <new>
+
+TransientDescriptorRing::TransientDescriptorRing(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptorsPerFrame,
+	uint32_t numFramesInFlight, D3D12_DESCRIPTOR_HEAP_FLAGS flags)
+	: m_HeapType(heapType)
+	, m_NumDescriptorsPerFrame(numDescriptorsPerFrame)
+	, m_Partitions(numFramesInFlight)
+	, m_CurrentPartition(0)
+	, m_PartitionBase(0)
+	, m_FrameOffset(0)
+{
+	auto& app = Application::Get();
+
+	m_DescriptorHeap = app.CreateDescriptorHeap(m_NumDescriptorsPerFrame * numFramesInFlight, m_HeapType, flags);
+	m_BaseCPUDescriptor = m_DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+	m_DescriptorHandleIncrementSize = app.GetDescriptorHandleIncrementSize(m_HeapType);
+
+	if (flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+	{
+		m_BaseGPUDescriptor = m_DescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+	}
+	else
+	{
+		m_BaseGPUDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_GPU_DESCRIPTOR_HANDLE{ 0 });
+	}
+}
+
+TransientDescriptorRing::~TransientDescriptorRing()
+{
+}
+
+uint32_t TransientDescriptorRing::Allocate(uint32_t numDescriptors)
+{
+	// Only move the offset when the request fits, so a failed allocation
+	// doesn't use up the space left for smaller ones.
+	uint32_t offset = m_FrameOffset.load(std::memory_order_relaxed);
+	do
+	{
+		if (numDescriptors > m_NumDescriptorsPerFrame - offset)
+		{
+			throw std::bad_alloc();
+		}
+	} while (!m_FrameOffset.compare_exchange_weak(offset, offset + numDescriptors, std::memory_order_relaxed));
+
+	return m_PartitionBase + offset;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE TransientDescriptorRing::GetCPUDescriptorHandle(uint32_t index) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_BaseCPUDescriptor, index, m_DescriptorHandleIncrementSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE TransientDescriptorRing::GetGPUDescriptorHandle(uint32_t index) const
+{
+	assert(m_BaseGPUDescriptor.ptr != 0);
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_BaseGPUDescriptor, index, m_DescriptorHandleIncrementSize);
+}
+
+void TransientDescriptorRing::Reset(std::shared_ptr<CommandQueue> commandQueue, uint64_t fenceValue)
+{
+	auto& current = m_Partitions[m_CurrentPartition];
+	current.Queue = std::move(commandQueue);
+	current.FenceValue = fenceValue;
+
+	m_CurrentPartition = (m_CurrentPartition + 1) % static_cast<uint32_t>(m_Partitions.size());
+
+	auto& next = m_Partitions[m_CurrentPartition];
+	if (next.Queue)
+	{
+		next.Queue->WaitForFenceValue(next.FenceValue);
+		next.Queue.reset();
+	}
+
+	m_PartitionBase = m_CurrentPartition * m_NumDescriptorsPerFrame;
+	m_FrameOffset.store(0, std::memory_order_relaxed);
+}
+
+uint32_t TransientDescriptorRing::GetNumAllocatedThisFrame() const
+{
+	return m_FrameOffset.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "../../Globals/stdafx.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CommandQueue;
+
+// Bump allocator for descriptors that only live for one frame. The heap is
+// split into one partition per frame in flight; allocating is a single atomic
+// compare-exchange on the current partition's offset and nothing is freed
+// individually. A partition is reused wholesale once the fence of the frame
+// that last used it has completed.
+class TransientDescriptorRing
+{
+public:
+	TransientDescriptorRing(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptorsPerFrame = 1024,
+		uint32_t numFramesInFlight = 3, D3D12_DESCRIPTOR_HEAP_FLAGS flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
+	virtual ~TransientDescriptorRing();
+
+	// Safe to call from any thread while recording the current frame. Throws
+	// std::bad_alloc when the frame's partition is exhausted.
+	uint32_t Allocate(uint32_t numDescriptors = 1);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(uint32_t index) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandle(uint32_t index) const;
+
+	// Closes the current frame, whose work completes at fenceValue on
+	// commandQueue, and moves to the next partition. Waits on the CPU only if
+	// that partition's frame is still in flight. Must not race with Allocate.
+	void Reset(std::shared_ptr<CommandQueue> commandQueue, uint64_t fenceValue);
+
+	ID3D12DescriptorHeap* GetDescriptorHeap() const { return m_DescriptorHeap.Get(); }
+	uint32_t GetNumAllocatedThisFrame() const;
+
+private:
+	struct FramePartition
+	{
+		std::shared_ptr<CommandQueue> Queue;
+		uint64_t FenceValue = 0;
+	};
+
+	ComPtr<ID3D12DescriptorHeap> m_DescriptorHeap;
+	D3D12_DESCRIPTOR_HEAP_TYPE m_HeapType;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE m_BaseCPUDescriptor;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE m_BaseGPUDescriptor;
+	uint32_t m_DescriptorHandleIncrementSize;
+	uint32_t m_NumDescriptorsPerFrame;
+
+	std::vector<FramePartition> m_Partitions;
+	uint32_t m_CurrentPartition;
+	uint32_t m_PartitionBase;
+
+	std::atomic<uint32_t> m_FrameOffset;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Lock-free multiple-producer, single-consumer queue. Push is a single CAS
+// loop onto an intrusive stack; the consumer takes everything pushed so far
+// with one exchange and sees it in push order. Push and IsEmpty are
+// sequentially consistent, so a consumer that publishes an idle flag and then
+// finds the queue empty can't miss a producer that pushed and then read the
+// flag as clear.
+template<typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue()
+		: m_Head(nullptr)
+	{}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	~MPSCQueue()
+	{
+		ConsumeAll([](T&&) {});
+	}
+
+	void Push(T value)
+	{
+		Node* node = new Node{ std::move(value), m_Head.load(std::memory_order_relaxed) };
+		while (!m_Head.compare_exchange_weak(node->Next, node, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// Consumer only. Calls consume on every queued value, oldest first, and
+	// returns how many there were.
+	template<typename Consume>
+	size_t ConsumeAll(Consume&& consume)
+	{
+		Node* head = m_Head.exchange(nullptr, std::memory_order_acquire);
+
+		Node* reversed = nullptr;
+		while (head)
+		{
+			Node* next = head->Next;
+			head->Next = reversed;
+			reversed = head;
+			head = next;
+		}
+
+		size_t count = 0;
+		while (reversed)
+		{
+			Node* next = reversed->Next;
+			consume(std::move(reversed->Value));
+			delete reversed;
+			reversed = next;
+			++count;
+		}
+
+		return count;
+	}
+
+	bool IsEmpty() const { return m_Head.load(std::memory_order_seq_cst) == nullptr; }
+
+private:
+	struct Node
+	{
+		T Value;
+		Node* Next;
+	};
+
+	std::atomic<Node*> m_Head;
+};
@@ -0,0 +1,237 @@
+#include "HeapSubAllocator.h"
+#include "../TLSFFreeList.h"
+
+#include <algorithm>
+#include <cassert>
+
+HeapSubAllocator::HeapSubAllocator(uint64_t blockSize, uint64_t granularity, uint64_t budget)
+	: m_BlockSize(blockSize)
+	, m_Granularity(granularity)
+	, m_Budget(budget)
+	, m_BlockBytes(0)
+	, m_UsedBytes(0)
+	, m_NumAllocations(0)
+{
+	assert(granularity > 0 && (granularity & (granularity - 1)) == 0);
+	assert(blockSize % granularity == 0 && blockSize / granularity <= UINT32_MAX);
+}
+
+HeapSubAllocator::~HeapSubAllocator()
+{}
+
+HeapSubAllocator::Allocation HeapSubAllocator::Allocate(uint64_t sizeInBytes, uint64_t alignment, uint32_t tag)
+{
+	auto tagBlocks = m_BlocksByTag.find(tag);
+	if (tagBlocks == m_BlocksByTag.end())
+	{
+		return Allocation();
+	}
+
+	for (uint32_t blockIndex : tagBlocks->second)
+	{
+		Allocation allocation = AllocateFromBlock(blockIndex, sizeInBytes, alignment);
+		if (allocation.IsValid())
+		{
+			return allocation;
+		}
+	}
+
+	return Allocation();
+}
+
+HeapSubAllocator::Allocation HeapSubAllocator::AllocateFromBlock(uint32_t blockIndex, uint64_t sizeInBytes, uint64_t alignment)
+{
+	auto& block = *m_Blocks[blockIndex];
+
+	uint64_t numUnits = (std::max<uint64_t>(sizeInBytes, 1) + m_Granularity - 1) / m_Granularity;
+	uint64_t alignUnits = std::max<uint64_t>(alignment / m_Granularity, 1);
+
+	// Over-allocate by the alignment slack and hand the unused head and tail
+	// straight back, since the free list can release any sub-range.
+	uint64_t paddedUnits = numUnits + alignUnits - 1;
+	if (paddedUnits > block.Size / m_Granularity)
+	{
+		return Allocation();
+	}
+
+	uint32_t offset = block.FreeList->Allocate(static_cast<uint32_t>(paddedUnits));
+	if (offset == TLSFFreeList::InvalidOffset)
+	{
+		return Allocation();
+	}
+
+	uint64_t alignedOffset = (offset + alignUnits - 1) & ~(alignUnits - 1);
+	uint64_t head = alignedOffset - offset;
+	uint64_t tail = paddedUnits - head - numUnits;
+
+	if (head > 0)
+	{
+		block.FreeList->Free(offset, static_cast<uint32_t>(head));
+	}
+
+	if (tail > 0)
+	{
+		block.FreeList->Free(static_cast<uint32_t>(alignedOffset + numUnits), static_cast<uint32_t>(tail));
+	}
+
+	Allocation allocation;
+	allocation.BlockIndex = blockIndex;
+	allocation.Offset = alignedOffset * m_Granularity;
+	allocation.Size = numUnits * m_Granularity;
+
+	block.UsedBytes += allocation.Size;
+	++block.NumAllocations;
+
+	m_UsedBytes += allocation.Size;
+	++m_NumAllocations;
+
+	return allocation;
+}
+
+void HeapSubAllocator::Free(const Allocation& allocation)
+{
+	if (!allocation.IsValid())
+	{
+		return;
+	}
+
+	auto& block = *m_Blocks[allocation.BlockIndex];
+	assert(block.NumAllocations > 0 && block.UsedBytes >= allocation.Size);
+
+	block.FreeList->Free(static_cast<uint32_t>(allocation.Offset / m_Granularity), static_cast<uint32_t>(allocation.Size / m_Granularity));
+
+	block.UsedBytes -= allocation.Size;
+	--block.NumAllocations;
+
+	m_UsedBytes -= allocation.Size;
+	--m_NumAllocations;
+}
+
+uint32_t HeapSubAllocator::AddBlock(uint64_t minSize, uint32_t tag)
+{
+	uint64_t size = std::max(m_BlockSize, (minSize + m_Granularity - 1) & ~(m_Granularity - 1));
+	if (size / m_Granularity > UINT32_MAX || m_BlockBytes + size > m_Budget)
+	{
+		return InvalidBlock;
+	}
+
+	auto block = std::make_unique<Block>();
+	block->FreeList = std::make_unique<TLSFFreeList>(static_cast<uint32_t>(size / m_Granularity));
+	block->Tag = tag;
+	block->Size = size;
+
+	m_BlockBytes += size;
+
+	uint32_t blockIndex;
+	auto freeSlot = std::find(m_Blocks.begin(), m_Blocks.end(), nullptr);
+	if (freeSlot != m_Blocks.end())
+	{
+		*freeSlot = std::move(block);
+		blockIndex = static_cast<uint32_t>(freeSlot - m_Blocks.begin());
+	}
+	else
+	{
+		m_Blocks.push_back(std::move(block));
+		blockIndex = static_cast<uint32_t>(m_Blocks.size() - 1);
+	}
+
+	auto& tagBlocks = m_BlocksByTag[tag];
+	tagBlocks.insert(std::lower_bound(tagBlocks.begin(), tagBlocks.end(), blockIndex), blockIndex);
+
+	return blockIndex;
+}
+
+void HeapSubAllocator::ReleaseBlock(uint32_t blockIndex)
+{
+	assert(IsBlockEmpty(blockIndex));
+
+	auto& tagBlocks = m_BlocksByTag[m_Blocks[blockIndex]->Tag];
+	tagBlocks.erase(std::lower_bound(tagBlocks.begin(), tagBlocks.end(), blockIndex));
+
+	m_BlockBytes -= m_Blocks[blockIndex]->Size;
+	m_Blocks[blockIndex].reset();
+}
+
+std::vector<uint32_t> HeapSubAllocator::ReleaseEmptyBlocks(uint32_t minBlocks)
+{
+	std::unordered_map<uint32_t, uint32_t> numEmptyByTag;
+	for (uint32_t i = 0; i < m_Blocks.size(); ++i)
+	{
+		if (IsBlockEmpty(i))
+		{
+			++numEmptyByTag[m_Blocks[i]->Tag];
+		}
+	}
+
+	// Keeps the highest-indexed empty blocks of each tag.
+	std::vector<uint32_t> released;
+	for (uint32_t i = 0; i < m_Blocks.size(); ++i)
+	{
+		if (!IsBlockEmpty(i))
+		{
+			continue;
+		}
+
+		uint32_t& numEmpty = numEmptyByTag[m_Blocks[i]->Tag];
+		if (numEmpty > minBlocks)
+		{
+			--numEmpty;
+			ReleaseBlock(i);
+			released.push_back(i);
+		}
+	}
+
+	return released;
+}
+
+std::vector<HeapSubAllocator::BlockInfo> HeapSubAllocator::GetDefragmentationCandidates(float maxOccupancy) const
+{
+	std::vector<BlockInfo> candidates;
+
+	for (uint32_t i = 0; i < m_Blocks.size(); ++i)
+	{
+		const auto& block = m_Blocks[i];
+		if (block && block->NumAllocations > 0 &&
+			static_cast<double>(block->UsedBytes) <= static_cast<double>(block->Size) * maxOccupancy)
+		{
+			candidates.push_back(GetBlockInfo(i));
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(),
+		[](const BlockInfo& a, const BlockInfo& b) { return a.UsedBytes * b.Size < b.UsedBytes * a.Size; });
+
+	return candidates;
+}
+
+HeapSubAllocator::BlockInfo HeapSubAllocator::GetBlockInfo(uint32_t blockIndex) const
+{
+	const auto& block = *m_Blocks[blockIndex];
+
+	BlockInfo info;
+	info.BlockIndex = blockIndex;
+	info.Tag = block.Tag;
+	info.Size = block.Size;
+	info.UsedBytes = block.UsedBytes;
+	info.NumAllocations = block.NumAllocations;
+	info.LargestFreeRange = static_cast<uint64_t>(block.FreeList->LargestFreeBlock()) * m_Granularity;
+
+	return info;
+}
+
+bool HeapSubAllocator::IsBlockEmpty(uint32_t blockIndex) const
+{
+	return blockIndex < m_Blocks.size() && m_Blocks[blockIndex] && m_Blocks[blockIndex]->NumAllocations == 0;
+}
+
+HeapSubAllocator::Statistics HeapSubAllocator::GetStatistics() const
+{
+	Statistics stats = {};
+	stats.NumBlocks = std::count_if(m_Blocks.begin(), m_Blocks.end(), [](const std::unique_ptr<Block>& block) { return block != nullptr; });
+	stats.BlockBytes = m_BlockBytes;
+	stats.UsedBytes = m_UsedBytes;
+	stats.NumAllocations = m_NumAllocations;
+	stats.Budget = m_Budget;
+
+	return stats;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class TLSFFreeList;
+
+// Device-independent bookkeeping for placing resources in heap blocks. Each
+// block is tracked by a TLSF free list in units of the placement granularity,
+// and blocks carry an opaque tag so callers can keep resource classes apart.
+// Not synchronised; the owner is expected to lock around it.
+class HeapSubAllocator
+{
+public:
+	static constexpr uint32_t InvalidBlock = ~0u;
+
+	struct Allocation
+	{
+		uint32_t BlockIndex = InvalidBlock;
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+
+		bool IsValid() const { return BlockIndex != InvalidBlock; }
+	};
+
+	struct BlockInfo
+	{
+		uint32_t BlockIndex;
+		uint32_t Tag;
+		uint64_t Size;
+		uint64_t UsedBytes;
+		uint32_t NumAllocations;
+		uint64_t LargestFreeRange;
+	};
+
+	struct Statistics
+	{
+		size_t NumBlocks;
+		uint64_t BlockBytes;
+		uint64_t UsedBytes;
+		uint64_t NumAllocations;
+		uint64_t Budget;
+	};
+
+	HeapSubAllocator(uint64_t blockSize, uint64_t granularity, uint64_t budget = UINT64_MAX);
+	virtual ~HeapSubAllocator();
+
+	// Places the request in the lowest-indexed block with the given tag that
+	// has room. Returns an invalid allocation if none does. Only blocks with
+	// the tag are visited, and each rejects a request it can't fit in constant
+	// time, so the cost is linear in the number of blocks with the tag.
+	Allocation Allocate(uint64_t sizeInBytes, uint64_t alignment, uint32_t tag);
+	Allocation AllocateFromBlock(uint32_t blockIndex, uint64_t sizeInBytes, uint64_t alignment);
+	void Free(const Allocation& allocation);
+
+	// Adds an empty block of the default size, or of minSize rounded up to the
+	// granularity if that is larger. Returns InvalidBlock if the block would
+	// take the total past the budget.
+	uint32_t AddBlock(uint64_t minSize, uint32_t tag);
+	void ReleaseBlock(uint32_t blockIndex);
+
+	// Releases empty blocks, keeping minBlocks empty ones per tag. Returns the
+	// released indices so the owner can destroy the backing heaps.
+	std::vector<uint32_t> ReleaseEmptyBlocks(uint32_t minBlocks = 0);
+
+	// Occupied blocks whose used bytes are at most maxOccupancy of their size,
+	// emptiest first. Moving their allocations elsewhere lets them be released.
+	std::vector<BlockInfo> GetDefragmentationCandidates(float maxOccupancy = 0.25f) const;
+
+	BlockInfo GetBlockInfo(uint32_t blockIndex) const;
+	bool IsBlockEmpty(uint32_t blockIndex) const;
+
+	uint64_t GetBlockSize() const { return m_BlockSize; }
+	uint64_t GetGranularity() const { return m_Granularity; }
+
+	void SetBudget(uint64_t budget) { m_Budget = budget; }
+	uint64_t GetBudget() const { return m_Budget; }
+
+	Statistics GetStatistics() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<TLSFFreeList> FreeList;
+		uint32_t Tag = 0;
+		uint64_t Size = 0;
+		uint64_t UsedBytes = 0;
+		uint32_t NumAllocations = 0;
+	};
+
+	uint64_t m_BlockSize;
+	uint64_t m_Granularity;
+	uint64_t m_Budget;
+
+	uint64_t m_BlockBytes;
+	uint64_t m_UsedBytes;
+	uint64_t m_NumAllocations;
+
+	// Released blocks leave a null entry whose index is reused by AddBlock.
+	std::vector<std::unique_ptr<Block>> m_Blocks;
+
+	// Live block indices per tag, in ascending order.
+	std::unordered_map<uint32_t, std::vector<uint32_t>> m_BlocksByTag;
+};
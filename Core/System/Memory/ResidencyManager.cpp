@@ -0,0 +1,161 @@
+#include "ResidencyManager.h"
+#include "../CommandQueue.h"
+#include "../../Application.h"
+#include "../../Globals/Helpers.h"
+
+static const D3D12_COMMAND_LIST_TYPE QueueTypes[ResidencyPolicy::MaxQueues] =
+{
+	D3D12_COMMAND_LIST_TYPE_DIRECT,
+	D3D12_COMMAND_LIST_TYPE_COMPUTE,
+	D3D12_COMMAND_LIST_TYPE_COPY,
+};
+
+static uint32_t GetQueueIndex(D3D12_COMMAND_LIST_TYPE type)
+{
+	for (uint32_t i = 0; i < ResidencyPolicy::MaxQueues; ++i)
+	{
+		if (QueueTypes[i] == type)
+		{
+			return i;
+		}
+	}
+
+	assert(false && "Unsupported queue type.");
+	return 0;
+}
+
+ResidencyManager::ResidencyManager(ComPtr<IDXGIAdapter4> adapter, DXGI_MEMORY_SEGMENT_GROUP segmentGroup)
+	: m_Adapter(adapter)
+	, m_SegmentGroup(segmentGroup)
+	, m_VideoMemoryInfo()
+	, m_ResidencyFenceValue(0)
+{
+	auto device = Application::Get().GetDevice();
+
+	// EnqueueMakeResident needs Windows 10 1709; older runtimes fall back to
+	// the blocking MakeResident.
+	if (SUCCEEDED(device.As(&m_Device3)))
+	{
+		ThrowIfFailed(device->CreateFence(m_ResidencyFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_ResidencyFence)));
+	}
+}
+
+ResidencyManager::~ResidencyManager()
+{}
+
+void ResidencyManager::Track(ID3D12Pageable* object, uint64_t sizeInBytes)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t id = m_Policy.Add(sizeInBytes);
+	if (m_Objects.size() <= id)
+	{
+		m_Objects.resize(id + 1);
+	}
+
+	m_Objects[id] = object;
+	m_ObjectIds[object] = id;
+}
+
+void ResidencyManager::Untrack(ID3D12Pageable* object)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_ObjectIds.find(object);
+	if (it != m_ObjectIds.end())
+	{
+		m_Policy.Remove(it->second);
+		m_Objects[it->second].Reset();
+		m_ObjectIds.erase(it);
+	}
+}
+
+void ResidencyManager::MarkUsed(ID3D12Pageable* object, const CommandQueue& queue, uint64_t fenceValue)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_ObjectIds.find(object);
+	if (it != m_ObjectIds.end())
+	{
+		m_Policy.MarkUsed(it->second, GetQueueIndex(queue.GetCommandListType()), fenceValue);
+	}
+}
+
+void ResidencyManager::MarkUsedPending(ID3D12Pageable* object, const CommandQueue& queue)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_ObjectIds.find(object);
+	if (it != m_ObjectIds.end())
+	{
+		m_Policy.MarkUsedPending(it->second, GetQueueIndex(queue.GetCommandListType()));
+	}
+}
+
+void ResidencyManager::ResolvePendingMarks(const CommandQueue& queue, uint64_t fenceValue)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Policy.ResolvePending(GetQueueIndex(queue.GetCommandListType()), fenceValue);
+}
+
+void ResidencyManager::Update(CommandQueue& queue)
+{
+	uint64_t completedFenceValues[ResidencyPolicy::MaxQueues];
+	for (uint32_t i = 0; i < ResidencyPolicy::MaxQueues; ++i)
+	{
+		completedFenceValues[i] = Application::Get().GetCommandQueue(QueueTypes[i])->GetCompletedFenceValue();
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	ThrowIfFailed(m_Adapter->QueryVideoMemoryInfo(0, m_SegmentGroup, &m_VideoMemoryInfo));
+
+	auto decision = m_Policy.Update(m_VideoMemoryInfo.Budget, m_VideoMemoryInfo.CurrentUsage, completedFenceValues);
+
+	std::vector<ID3D12Pageable*> objects;
+	objects.reserve(std::max(decision.MakeResident.size(), decision.Evict.size()));
+
+	auto device = Application::Get().GetDevice();
+
+	if (!decision.MakeResident.empty())
+	{
+		for (uint32_t id : decision.MakeResident)
+		{
+			objects.push_back(m_Objects[id].Get());
+		}
+
+		if (m_Device3)
+		{
+			ThrowIfFailed(m_Device3->EnqueueMakeResident(D3D12_RESIDENCY_FLAG_NONE, static_cast<UINT>(objects.size()), objects.data(),
+				m_ResidencyFence.Get(), ++m_ResidencyFenceValue));
+			ThrowIfFailed(queue.GetCommandQueue()->Wait(m_ResidencyFence.Get(), m_ResidencyFenceValue));
+		}
+		else
+		{
+			ThrowIfFailed(device->MakeResident(static_cast<UINT>(objects.size()), objects.data()));
+		}
+	}
+
+	if (!decision.Evict.empty())
+	{
+		objects.clear();
+		for (uint32_t id : decision.Evict)
+		{
+			objects.push_back(m_Objects[id].Get());
+		}
+
+		ThrowIfFailed(device->Evict(static_cast<UINT>(objects.size()), objects.data()));
+	}
+}
+
+DXGI_QUERY_VIDEO_MEMORY_INFO ResidencyManager::GetVideoMemoryInfo()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_VideoMemoryInfo;
+}
+
+ResidencyPolicy::Statistics ResidencyManager::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Policy.GetStatistics();
+}
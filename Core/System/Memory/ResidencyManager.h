@@ -0,0 +1,61 @@
+#pragma once
+#include "../../Globals/stdafx.h"
+#include "ResidencyPolicy.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class CommandQueue;
+
+// Keeps tracked heaps and resources within the adapter's video memory budget.
+// Uses are marked against the queue that does the work, and an object is only
+// evicted once every queue that used it has passed its mark.
+class ResidencyManager
+{
+public:
+	explicit ResidencyManager(ComPtr<IDXGIAdapter4> adapter, DXGI_MEMORY_SEGMENT_GROUP segmentGroup = DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+	virtual ~ResidencyManager();
+
+	void Track(ID3D12Pageable* object, uint64_t sizeInBytes);
+	void Untrack(ID3D12Pageable* object);
+
+	// Untracked objects are ignored. For work submitted without knowing its
+	// fence value up front, such as streamed uploads, mark with the value the
+	// submission returns before the next Update.
+	void MarkUsed(ID3D12Pageable* object, const CommandQueue& queue, uint64_t fenceValue);
+
+	// Marks a use by the next submission on queue, before its fence value is
+	// known; the object is kept resident and never evicted until
+	// ResolvePendingMarks records the value that submission returned. Resolve
+	// before the next Update.
+	void MarkUsedPending(ID3D12Pageable* object, const CommandQueue& queue);
+	void ResolvePendingMarks(const CommandQueue& queue, uint64_t fenceValue);
+
+	// Queries the budget, makes evicted objects marked used since the last
+	// update resident and evicts least recently used ones while over budget,
+	// one call each. Objects are made resident with EnqueueMakeResident where
+	// the device supports it, and queue waits for that on the GPU instead of
+	// the CPU blocking; other queues must wait on queue before using them.
+	// Call before submitting the work the marks were for.
+	void Update(CommandQueue& queue);
+
+	DXGI_QUERY_VIDEO_MEMORY_INFO GetVideoMemoryInfo();
+	ResidencyPolicy::Statistics GetStatistics();
+
+private:
+	ComPtr<IDXGIAdapter4> m_Adapter;
+	DXGI_MEMORY_SEGMENT_GROUP m_SegmentGroup;
+	DXGI_QUERY_VIDEO_MEMORY_INFO m_VideoMemoryInfo;
+
+	ComPtr<ID3D12Device3> m_Device3;
+	ComPtr<ID3D12Fence> m_ResidencyFence;
+	uint64_t m_ResidencyFenceValue;
+
+	ResidencyPolicy m_Policy;
+	std::unordered_map<ID3D12Pageable*, uint32_t> m_ObjectIds;
+	// Indexed by policy object id.
+	std::vector<ComPtr<ID3D12Pageable>> m_Objects;
+
+	std::mutex m_Mutex;
+};
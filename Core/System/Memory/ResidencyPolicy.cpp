@@ -0,0 +1,146 @@
+#include "ResidencyPolicy.h"
+
+#include <algorithm>
+#include <cassert>
+
+uint32_t ResidencyPolicy::Add(uint64_t sizeInBytes)
+{
+	uint32_t object;
+	if (!m_FreeObjects.empty())
+	{
+		object = m_FreeObjects.back();
+		m_FreeObjects.pop_back();
+	}
+	else
+	{
+		object = static_cast<uint32_t>(m_Objects.size());
+		m_Objects.emplace_back();
+	}
+
+	auto& entry = m_Objects[object];
+	entry = Object();
+	entry.Size = sizeInBytes;
+	entry.InUse = true;
+	entry.Resident = true;
+	entry.LRUPosition = m_LRU.insert(m_LRU.end(), object);
+
+	return object;
+}
+
+void ResidencyPolicy::Remove(uint32_t object)
+{
+	auto& entry = m_Objects[object];
+	assert(entry.InUse);
+
+	m_LRU.erase(entry.LRUPosition);
+	entry = Object();
+
+	m_FreeObjects.push_back(object);
+}
+
+void ResidencyPolicy::MarkUsed(uint32_t object, uint32_t queue, uint64_t fenceValue)
+{
+	auto& entry = m_Objects[object];
+	assert(entry.InUse && queue < MaxQueues);
+
+	entry.LastUsedFences[queue] = std::max(entry.LastUsedFences[queue], fenceValue);
+	entry.NeedsResidency = !entry.Resident;
+
+	m_LRU.splice(m_LRU.end(), m_LRU, entry.LRUPosition);
+}
+
+void ResidencyPolicy::MarkUsedPending(uint32_t object, uint32_t queue)
+{
+	MarkUsed(object, queue, PendingFence);
+	m_PendingObjects[queue].push_back(object);
+}
+
+void ResidencyPolicy::ResolvePending(uint32_t queue, uint64_t fenceValue)
+{
+	for (uint32_t object : m_PendingObjects[queue])
+	{
+		// Objects removed since, and any new ones reusing their ids, no longer
+		// hold the pending value.
+		auto& entry = m_Objects[object];
+		if (entry.InUse && entry.LastUsedFences[queue] == PendingFence)
+		{
+			entry.LastUsedFences[queue] = fenceValue;
+		}
+	}
+
+	m_PendingObjects[queue].clear();
+}
+
+ResidencyPolicy::Decision ResidencyPolicy::Update(uint64_t budget, uint64_t currentUsage, const uint64_t* completedFenceValues)
+{
+	auto isIdle = [completedFenceValues](const Object& entry)
+	{
+		for (uint32_t queue = 0; queue < MaxQueues; ++queue)
+		{
+			if (entry.LastUsedFences[queue] > completedFenceValues[queue])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	Decision decision;
+
+	uint64_t projectedUsage = currentUsage;
+
+	for (uint32_t object : m_LRU)
+	{
+		auto& entry = m_Objects[object];
+		if (entry.NeedsResidency)
+		{
+			entry.NeedsResidency = false;
+			entry.Resident = true;
+			projectedUsage += entry.Size;
+
+			decision.MakeResident.push_back(object);
+		}
+	}
+
+	for (auto it = m_LRU.begin(); it != m_LRU.end() && projectedUsage > budget; ++it)
+	{
+		auto& entry = m_Objects[*it];
+		if (entry.Resident && isIdle(entry))
+		{
+			entry.Resident = false;
+			projectedUsage -= std::min(projectedUsage, entry.Size);
+
+			decision.Evict.push_back(*it);
+		}
+	}
+
+	m_NumMadeResident += decision.MakeResident.size();
+	m_NumEvictions += decision.Evict.size();
+
+	return decision;
+}
+
+ResidencyPolicy::Statistics ResidencyPolicy::GetStatistics() const
+{
+	Statistics stats = {};
+	stats.NumObjects = m_LRU.size();
+	stats.NumEvictions = m_NumEvictions;
+	stats.NumMadeResident = m_NumMadeResident;
+
+	for (uint32_t object : m_LRU)
+	{
+		const auto& entry = m_Objects[object];
+		if (entry.Resident)
+		{
+			++stats.NumResident;
+			stats.ResidentBytes += entry.Size;
+		}
+		else
+		{
+			stats.EvictedBytes += entry.Size;
+		}
+	}
+
+	return stats;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+// Decides what to evict and what to bring back. Objects are kept in least
+// recently used order with their size and, for each queue, the fence of their
+// last use there; the caller feeds in the budget, usage and completed fence
+// readings, so this has no device dependency. Not synchronised; the owner is
+// expected to lock around it.
+class ResidencyPolicy
+{
+public:
+	static constexpr uint32_t InvalidObject = ~0u;
+	static constexpr uint32_t MaxQueues = 3;
+	static constexpr uint64_t PendingFence = UINT64_MAX;
+
+	struct Decision
+	{
+		std::vector<uint32_t> Evict;
+		std::vector<uint32_t> MakeResident;
+	};
+
+	struct Statistics
+	{
+		size_t NumObjects;
+		size_t NumResident;
+		uint64_t ResidentBytes;
+		uint64_t EvictedBytes;
+		uint64_t NumEvictions;
+		uint64_t NumMadeResident;
+	};
+
+	// New objects are resident and most recently used.
+	uint32_t Add(uint64_t sizeInBytes);
+	void Remove(uint32_t object);
+
+	// Records that work finishing at fenceValue on the given queue uses the
+	// object. An evicted object is made resident again by the next Update,
+	// which must run before that work is submitted.
+	void MarkUsed(uint32_t object, uint32_t queue, uint64_t fenceValue);
+
+	// For work whose fence value is only known once it is submitted. The
+	// object counts as busy on the queue until ResolvePending records the
+	// value the submission returned, which must happen before the next Update.
+	void MarkUsedPending(uint32_t object, uint32_t queue);
+	void ResolvePending(uint32_t queue, uint64_t fenceValue);
+
+	// Brings back every evicted object marked used since the last update, then
+	// evicts least recently used objects every queue is done with until usage
+	// fits the budget or nothing more can go. completedFenceValues holds one
+	// value per queue.
+	Decision Update(uint64_t budget, uint64_t currentUsage, const uint64_t* completedFenceValues);
+
+	bool IsResident(uint32_t object) const { return m_Objects[object].Resident; }
+	uint64_t GetSize(uint32_t object) const { return m_Objects[object].Size; }
+
+	Statistics GetStatistics() const;
+
+private:
+	struct Object
+	{
+		uint64_t Size = 0;
+		uint64_t LastUsedFences[MaxQueues] = {};
+		bool InUse = false;
+		bool Resident = false;
+		bool NeedsResidency = false;
+		std::list<uint32_t>::iterator LRUPosition;
+	};
+
+	std::vector<Object> m_Objects;
+	std::vector<uint32_t> m_FreeObjects;
+	std::vector<uint32_t> m_PendingObjects[MaxQueues];
+
+	// Front is least recently used.
+	std::list<uint32_t> m_LRU;
+
+	uint64_t m_NumEvictions = 0;
+	uint64_t m_NumMadeResident = 0;
+};
@@ -0,0 +1,301 @@
+#include "ResourceAllocator.h"
+#include "ResidencyManager.h"
+#include "../../Application.h"
+#include "../../Globals/d3dx12.h"
+
+#include <mutex>
+#include <new>
+
+namespace
+{
+	enum ResourceClass : uint32_t
+	{
+		ResourceClass_Buffer,
+		ResourceClass_RenderTargetTexture,
+		ResourceClass_Texture,
+	};
+
+	ResourceClass GetResourceClass(const D3D12_RESOURCE_DESC& desc)
+	{
+		if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return ResourceClass_Buffer;
+		}
+
+		if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		{
+			return ResourceClass_RenderTargetTexture;
+		}
+
+		return ResourceClass_Texture;
+	}
+
+	D3D12_HEAP_FLAGS GetHeapFlags(uint32_t resourceClass)
+	{
+		switch (resourceClass)
+		{
+		case ResourceClass_Buffer:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+		case ResourceClass_RenderTargetTexture:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		default:
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+		}
+	}
+}
+
+class ResourceHeapPool : public std::enable_shared_from_this<ResourceHeapPool>
+{
+public:
+	ResourceHeapPool(D3D12_HEAP_TYPE heapType, uint64_t blockSize, ResidencyManager* residencyManager)
+		: m_HeapType(heapType)
+		, m_SubAllocator(blockSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)
+		, m_ResidencyManager(residencyManager)
+	{}
+
+	~ResourceHeapPool()
+	{
+		for (auto& heap : m_Heaps)
+		{
+			ReleaseHeap(heap);
+		}
+	}
+
+	ResourceAllocation CreateResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue)
+	{
+		auto device = Application::Get().GetDevice();
+
+		D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+		if (info.SizeInBytes == UINT64_MAX)
+		{
+			// The runtime reports an invalid description this way.
+			ThrowIfFailed(E_INVALIDARG);
+		}
+
+		uint32_t resourceClass = GetResourceClass(desc);
+
+		HeapSubAllocator::Allocation range;
+		ID3D12Heap* heap = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			range = m_SubAllocator.Allocate(info.SizeInBytes, info.Alignment, resourceClass);
+			if (!range.IsValid())
+			{
+				uint32_t blockIndex = m_SubAllocator.AddBlock(info.SizeInBytes, resourceClass);
+				if (blockIndex == HeapSubAllocator::InvalidBlock)
+				{
+					throw std::bad_alloc();
+				}
+
+				// Render target and depth blocks may hold MSAA surfaces.
+				const CD3DX12_HEAP_DESC HeapDesc(m_SubAllocator.GetBlockInfo(blockIndex).Size, m_HeapType,
+					resourceClass == ResourceClass_RenderTargetTexture ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+					GetHeapFlags(resourceClass));
+
+				ComPtr<ID3D12Heap> newHeap;
+				HRESULT hr = device->CreateHeap(&HeapDesc, IID_PPV_ARGS(&newHeap));
+				if (FAILED(hr))
+				{
+					m_SubAllocator.ReleaseBlock(blockIndex);
+					ThrowIfFailed(hr);
+				}
+
+				if (m_Heaps.size() <= blockIndex)
+				{
+					m_Heaps.resize(blockIndex + 1);
+				}
+
+				m_Heaps[blockIndex] = newHeap;
+
+				if (m_ResidencyManager)
+				{
+					m_ResidencyManager->Track(newHeap.Get(), HeapDesc.SizeInBytes);
+				}
+
+				range = m_SubAllocator.AllocateFromBlock(blockIndex, info.SizeInBytes, info.Alignment);
+			}
+
+			heap = m_Heaps[range.BlockIndex].Get();
+		}
+
+		ResourceAllocation allocation;
+
+		HRESULT hr = device->CreatePlacedResource(heap, range.Offset, &desc, initialState, clearValue, IID_PPV_ARGS(&allocation.m_Resource));
+		if (FAILED(hr))
+		{
+			Free(range);
+			ThrowIfFailed(hr);
+		}
+
+		allocation.m_Heap = heap;
+		allocation.m_Allocation = range;
+		allocation.m_Pool = shared_from_this();
+
+		return allocation;
+	}
+
+	void Free(const HeapSubAllocator::Allocation& range)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_SubAllocator.Free(range);
+
+		// Oversized blocks were made for a single resource; don't keep them.
+		if (m_SubAllocator.IsBlockEmpty(range.BlockIndex) &&
+			m_SubAllocator.GetBlockInfo(range.BlockIndex).Size > m_SubAllocator.GetBlockSize())
+		{
+			m_SubAllocator.ReleaseBlock(range.BlockIndex);
+			ReleaseHeap(m_Heaps[range.BlockIndex]);
+		}
+	}
+
+	size_t TrimEmptyBlocks(uint32_t minBlocks)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		auto released = m_SubAllocator.ReleaseEmptyBlocks(minBlocks);
+		for (uint32_t blockIndex : released)
+		{
+			ReleaseHeap(m_Heaps[blockIndex]);
+		}
+
+		return released.size();
+	}
+
+	void SetBudget(uint64_t budget)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_SubAllocator.SetBudget(budget);
+	}
+
+	std::vector<HeapSubAllocator::BlockInfo> GetDefragmentationCandidates(float maxOccupancy)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_SubAllocator.GetDefragmentationCandidates(maxOccupancy);
+	}
+
+	HeapSubAllocator::Statistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_SubAllocator.GetStatistics();
+	}
+
+private:
+	void ReleaseHeap(ComPtr<ID3D12Heap>& heap)
+	{
+		if (heap && m_ResidencyManager)
+		{
+			m_ResidencyManager->Untrack(heap.Get());
+		}
+
+		heap.Reset();
+	}
+
+	D3D12_HEAP_TYPE m_HeapType;
+	HeapSubAllocator m_SubAllocator;
+	ResidencyManager* m_ResidencyManager;
+	std::vector<ComPtr<ID3D12Heap>> m_Heaps;
+	std::mutex m_Mutex;
+};
+
+ResourceAllocation::ResourceAllocation()
+	: m_Heap(nullptr)
+{}
+
+ResourceAllocation::ResourceAllocation(ResourceAllocation&& allocation)
+	: m_Resource(std::move(allocation.m_Resource))
+	, m_Heap(allocation.m_Heap)
+	, m_Allocation(allocation.m_Allocation)
+	, m_Pool(std::move(allocation.m_Pool))
+{
+	allocation.m_Heap = nullptr;
+	allocation.m_Allocation = HeapSubAllocator::Allocation();
+}
+
+ResourceAllocation& ResourceAllocation::operator=(ResourceAllocation&& other)
+{
+	if (this != &other)
+	{
+		Release();
+
+		m_Resource = std::move(other.m_Resource);
+		m_Heap = other.m_Heap;
+		m_Allocation = other.m_Allocation;
+		m_Pool = std::move(other.m_Pool);
+
+		other.m_Heap = nullptr;
+		other.m_Allocation = HeapSubAllocator::Allocation();
+	}
+
+	return *this;
+}
+
+ResourceAllocation::~ResourceAllocation()
+{
+	Release();
+}
+
+void ResourceAllocation::Release()
+{
+	// The resource must go before its range can be reused.
+	m_Resource.Reset();
+
+	if (m_Pool)
+	{
+		m_Pool->Free(m_Allocation);
+		m_Pool.reset();
+	}
+
+	m_Heap = nullptr;
+	m_Allocation = HeapSubAllocator::Allocation();
+}
+
+ResourceAllocator::ResourceAllocator(uint64_t blockSize, ResidencyManager* residencyManager)
+{
+	const D3D12_HEAP_TYPE HeapTypes[] = { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_TYPE_READBACK };
+	for (auto heapType : HeapTypes)
+	{
+		GetPool(heapType) = std::make_shared<ResourceHeapPool>(heapType, blockSize, residencyManager);
+	}
+}
+
+ResourceAllocator::~ResourceAllocator()
+{}
+
+ResourceAllocation ResourceAllocator::CreateResource(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue)
+{
+	return GetPool(heapType)->CreateResource(desc, initialState, clearValue);
+}
+
+void ResourceAllocator::SetBudget(D3D12_HEAP_TYPE heapType, uint64_t budget)
+{
+	GetPool(heapType)->SetBudget(budget);
+}
+
+size_t ResourceAllocator::TrimEmptyBlocks(uint32_t minBlocks)
+{
+	size_t numReleased = 0;
+	for (auto& pool : m_Pools)
+	{
+		numReleased += pool->TrimEmptyBlocks(minBlocks);
+	}
+
+	return numReleased;
+}
+
+std::vector<HeapSubAllocator::BlockInfo> ResourceAllocator::GetDefragmentationCandidates(D3D12_HEAP_TYPE heapType, float maxOccupancy)
+{
+	return GetPool(heapType)->GetDefragmentationCandidates(maxOccupancy);
+}
+
+HeapSubAllocator::Statistics ResourceAllocator::GetStatistics(D3D12_HEAP_TYPE heapType)
+{
+	return GetPool(heapType)->GetStatistics();
+}
+
+std::shared_ptr<ResourceHeapPool>& ResourceAllocator::GetPool(D3D12_HEAP_TYPE heapType)
+{
+	assert(heapType >= D3D12_HEAP_TYPE_DEFAULT && heapType <= D3D12_HEAP_TYPE_READBACK);
+	return m_Pools[heapType - D3D12_HEAP_TYPE_DEFAULT];
+}
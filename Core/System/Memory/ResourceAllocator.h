@@ -0,0 +1,76 @@
+#pragma once
+#include "../../Globals/stdafx.h"
+#include "../../Globals/Helpers.h"
+#include "HeapSubAllocator.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ResidencyManager;
+class ResourceHeapPool;
+
+// A placed resource and the heap range it lives in. The range goes back to
+// its block when the allocation is released or destroyed, so the GPU must be
+// done with the resource by then.
+class ResourceAllocation
+{
+public:
+	ResourceAllocation();
+	ResourceAllocation(ResourceAllocation&& allocation);
+	ResourceAllocation& operator=(ResourceAllocation&& other);
+
+	ResourceAllocation(const ResourceAllocation&) = delete;
+	ResourceAllocation& operator=(const ResourceAllocation&) = delete;
+
+	~ResourceAllocation();
+
+	bool IsNull() const { return m_Resource == nullptr; }
+
+	ID3D12Resource* GetResource() const { return m_Resource.Get(); }
+	ID3D12Heap* GetHeap() const { return m_Heap; }
+	uint64_t GetHeapOffset() const { return m_Allocation.Offset; }
+	uint32_t GetBlockIndex() const { return m_Allocation.BlockIndex; }
+
+	void Release();
+
+private:
+	friend class ResourceHeapPool;
+
+	ComPtr<ID3D12Resource> m_Resource;
+	ID3D12Heap* m_Heap;
+	HeapSubAllocator::Allocation m_Allocation;
+	std::shared_ptr<ResourceHeapPool> m_Pool;
+};
+
+// Creates placed resources in large ID3D12Heap blocks, one pool per heap type.
+// Buffers, render target/depth textures and other textures get separate blocks
+// so the same layout works on resource heap tier 1. Requests larger than a
+// block get a block of their own, which is released as soon as it empties.
+// With a residency manager, every heap is tracked by it while it exists.
+class ResourceAllocator
+{
+public:
+	explicit ResourceAllocator(uint64_t blockSize = _64MB, ResidencyManager* residencyManager = nullptr);
+	virtual ~ResourceAllocator();
+
+	// Throws std::bad_alloc if a new block is needed and would exceed the heap
+	// type's budget, and fails with E_INVALIDARG if the device rejects desc.
+	ResourceAllocation CreateResource(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue = nullptr);
+
+	void SetBudget(D3D12_HEAP_TYPE heapType, uint64_t budget);
+
+	// Destroys empty heaps, keeping minBlocks per resource class for reuse.
+	// Returns the number of heaps destroyed.
+	size_t TrimEmptyBlocks(uint32_t minBlocks = 1);
+
+	std::vector<HeapSubAllocator::BlockInfo> GetDefragmentationCandidates(D3D12_HEAP_TYPE heapType, float maxOccupancy = 0.25f);
+
+	HeapSubAllocator::Statistics GetStatistics(D3D12_HEAP_TYPE heapType);
+
+private:
+	std::shared_ptr<ResourceHeapPool>& GetPool(D3D12_HEAP_TYPE heapType);
+
+	std::shared_ptr<ResourceHeapPool> m_Pools[3];
+};
@@ -0,0 +1,115 @@
+#include "TransientAliasingPlanner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+uint32_t TransientAliasingPlanner::AddResource(uint64_t sizeInBytes, uint64_t alignment, uint32_t firstPass, uint32_t lastPass)
+{
+	assert(firstPass <= lastPass);
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	m_Resources.push_back({ sizeInBytes, alignment, firstPass, lastPass });
+	return static_cast<uint32_t>(m_Resources.size() - 1);
+}
+
+TransientAliasingPlanner::Plan TransientAliasingPlanner::Compile() const
+{
+	Plan plan;
+	plan.Offsets.resize(m_Resources.size());
+
+	auto livesOverlap = [this](uint32_t a, uint32_t b)
+	{
+		return m_Resources[a].FirstPass <= m_Resources[b].LastPass && m_Resources[b].FirstPass <= m_Resources[a].LastPass;
+	};
+
+	auto memoryOverlaps = [this, &plan](uint32_t a, uint32_t b)
+	{
+		return plan.Offsets[a] < plan.Offsets[b] + m_Resources[b].Size && plan.Offsets[b] < plan.Offsets[a] + m_Resources[a].Size;
+	};
+
+	std::vector<uint32_t> order(m_Resources.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+		{
+			if (m_Resources[a].Size != m_Resources[b].Size)
+			{
+				return m_Resources[a].Size > m_Resources[b].Size;
+			}
+
+			return m_Resources[a].FirstPass < m_Resources[b].FirstPass;
+		});
+
+	std::vector<uint32_t> placed;
+	std::vector<uint32_t> conflicts;
+	placed.reserve(m_Resources.size());
+
+	for (uint32_t index : order)
+	{
+		const auto& resource = m_Resources[index];
+
+		conflicts.clear();
+		for (uint32_t other : placed)
+		{
+			if (livesOverlap(index, other))
+			{
+				conflicts.push_back(other);
+			}
+		}
+
+		std::sort(conflicts.begin(), conflicts.end(),
+			[&plan](uint32_t a, uint32_t b) { return plan.Offsets[a] < plan.Offsets[b]; });
+
+		// Walk the live ranges in address order and take the first gap that fits.
+		uint64_t offset = 0;
+		for (uint32_t other : conflicts)
+		{
+			uint64_t candidate = AlignUp(offset, resource.Alignment);
+			if (candidate + resource.Size <= plan.Offsets[other])
+			{
+				break;
+			}
+
+			offset = std::max(offset, plan.Offsets[other] + m_Resources[other].Size);
+		}
+
+		plan.Offsets[index] = AlignUp(offset, resource.Alignment);
+		plan.HeapSize = std::max(plan.HeapSize, plan.Offsets[index] + resource.Size);
+		plan.UnaliasedSize = AlignUp(plan.UnaliasedSize, resource.Alignment) + resource.Size;
+
+		placed.push_back(index);
+	}
+
+	// A resource needs an aliasing barrier on first use if any earlier resource
+	// used part of its memory. With a single predecessor the barrier can name
+	// it; otherwise it is left open.
+	for (uint32_t index = 0; index < m_Resources.size(); ++index)
+	{
+		uint32_t before = InvalidResource;
+		uint32_t numBefore = 0;
+
+		for (uint32_t other = 0; other < m_Resources.size(); ++other)
+		{
+			if (other != index && m_Resources[other].LastPass < m_Resources[index].FirstPass && memoryOverlaps(index, other))
+			{
+				before = other;
+				++numBefore;
+			}
+		}
+
+		if (numBefore > 0)
+		{
+			plan.Barriers.push_back({ m_Resources[index].FirstPass, numBefore == 1 ? before : InvalidResource, index });
+		}
+	}
+
+	std::stable_sort(plan.Barriers.begin(), plan.Barriers.end(),
+		[](const AliasingBarrier& a, const AliasingBarrier& b) { return a.Pass < b.Pass; });
+
+	return plan;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packs frame-local resources into one heap region by lifetime. Passes are
+// numbered in submission order and a resource is live from its first to its
+// last use, inclusive. Resources whose lifetimes don't overlap may share
+// memory, and the plan lists the aliasing barriers needed where they do.
+class TransientAliasingPlanner
+{
+public:
+	static constexpr uint32_t InvalidResource = ~0u;
+
+	struct AliasingBarrier
+	{
+		uint32_t Pass;
+		// InvalidResource when more than one earlier resource used the memory.
+		uint32_t Before;
+		uint32_t After;
+	};
+
+	struct Plan
+	{
+		std::vector<uint64_t> Offsets;
+		// Sorted by pass.
+		std::vector<AliasingBarrier> Barriers;
+		uint64_t HeapSize = 0;
+		uint64_t UnaliasedSize = 0;
+	};
+
+	uint32_t AddResource(uint64_t sizeInBytes, uint64_t alignment, uint32_t firstPass, uint32_t lastPass);
+	void Clear() { m_Resources.clear(); }
+
+	size_t GetNumResources() const { return m_Resources.size(); }
+
+	// Places the largest resources first, each at the lowest offset that
+	// doesn't collide with anything already placed and live at the same time.
+	// This is greedy interval colouring where a colour is a byte range.
+	Plan Compile() const;
+
+private:
+	struct Resource
+	{
+		uint64_t Size;
+		uint64_t Alignment;
+		uint32_t FirstPass;
+		uint32_t LastPass;
+	};
+
+	std::vector<Resource> m_Resources;
+};
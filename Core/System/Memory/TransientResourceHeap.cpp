@@ -0,0 +1,90 @@
+#include "TransientResourceHeap.h"
+#include "../../Application.h"
+#include "../../Globals/Helpers.h"
+#include "../../Globals/d3dx12.h"
+
+#include <algorithm>
+
+TransientResourceHeap::TransientResourceHeap()
+	: m_HeapSize(0)
+{}
+
+TransientResourceHeap::~TransientResourceHeap()
+{}
+
+uint32_t TransientResourceHeap::AddResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, uint32_t firstPass, uint32_t lastPass)
+{
+	assert(desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER &&
+		(desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)));
+
+	auto device = Application::Get().GetDevice();
+	D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+
+	TransientResource resource = {};
+	resource.Desc = desc;
+	resource.InitialState = initialState;
+	resource.HasClearValue = clearValue != nullptr;
+	if (clearValue)
+	{
+		resource.ClearValue = *clearValue;
+	}
+
+	m_Resources.push_back(resource);
+	return m_Planner.AddResource(info.SizeInBytes, info.Alignment, firstPass, lastPass);
+}
+
+void TransientResourceHeap::Build()
+{
+	auto device = Application::Get().GetDevice();
+
+	m_Plan = m_Planner.Compile();
+
+	if (m_Plan.HeapSize > m_HeapSize)
+	{
+		for (auto& resource : m_Resources)
+		{
+			resource.Resource.Reset();
+		}
+
+		m_Heap.Reset();
+		m_HeapSize = std::max<uint64_t>(m_Plan.HeapSize, D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT);
+
+		const CD3DX12_HEAP_DESC HeapDesc(m_HeapSize, D3D12_HEAP_TYPE_DEFAULT,
+			D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+
+		ThrowIfFailed(device->CreateHeap(&HeapDesc, IID_PPV_ARGS(&m_Heap)));
+	}
+
+	for (uint32_t i = 0; i < m_Resources.size(); ++i)
+	{
+		auto& resource = m_Resources[i];
+
+		ThrowIfFailed(device->CreatePlacedResource(m_Heap.Get(), m_Plan.Offsets[i], &resource.Desc, resource.InitialState,
+			resource.HasClearValue ? &resource.ClearValue : nullptr, IID_PPV_ARGS(&resource.Resource)));
+	}
+}
+
+void TransientResourceHeap::Clear()
+{
+	m_Resources.clear();
+	m_Planner.Clear();
+	m_Plan = TransientAliasingPlanner::Plan();
+}
+
+void TransientResourceHeap::AliasingBarriers(ComPtr<ID3D12GraphicsCommandList2> commandList, uint32_t pass)
+{
+	auto first = std::lower_bound(m_Plan.Barriers.begin(), m_Plan.Barriers.end(), pass,
+		[](const TransientAliasingPlanner::AliasingBarrier& barrier, uint32_t value) { return barrier.Pass < value; });
+
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	for (auto it = first; it != m_Plan.Barriers.end() && it->Pass == pass; ++it)
+	{
+		ID3D12Resource* before = it->Before != TransientAliasingPlanner::InvalidResource ? GetResource(it->Before) : nullptr;
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(before, GetResource(it->After)));
+	}
+
+	if (!barriers.empty())
+	{
+		commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../../Globals/stdafx.h"
+#include "TransientAliasingPlanner.h"
+
+#include <cstdint>
+#include <vector>
+
+// Frame-local render and depth targets placed in one heap by their pass
+// lifetimes, so targets that are never live together share memory. Contents
+// don't survive aliasing: a target's first pass must clear or discard it.
+class TransientResourceHeap
+{
+public:
+	TransientResourceHeap();
+	virtual ~TransientResourceHeap();
+
+	// Only render target and depth stencil textures can be added.
+	uint32_t AddResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* clearValue, uint32_t firstPass, uint32_t lastPass);
+
+	// Plans the layout, grows the heap if needed and places every resource.
+	// The GPU must be done with the previous set.
+	void Build();
+
+	// Drops the resource list so the next frame's set can be added.
+	void Clear();
+
+	ID3D12Resource* GetResource(uint32_t index) const { return m_Resources[index].Resource.Get(); }
+
+	// Records the aliasing barriers due before pass runs.
+	void AliasingBarriers(ComPtr<ID3D12GraphicsCommandList2> commandList, uint32_t pass);
+
+	uint64_t GetHeapSize() const { return m_HeapSize; }
+	uint64_t GetUnaliasedSize() const { return m_Plan.UnaliasedSize; }
+
+private:
+	struct TransientResource
+	{
+		D3D12_RESOURCE_DESC Desc;
+		D3D12_RESOURCE_STATES InitialState;
+		D3D12_CLEAR_VALUE ClearValue;
+		bool HasClearValue;
+		ComPtr<ID3D12Resource> Resource;
+	};
+
+	TransientAliasingPlanner m_Planner;
+	TransientAliasingPlanner::Plan m_Plan;
+
+	std::vector<TransientResource> m_Resources;
+
+	ComPtr<ID3D12Heap> m_Heap;
+	uint64_t m_HeapSize;
+};
@@ -0,0 +1,187 @@
+#include "ParallelRecordingContext.h"
+#include "CommandQueue.h"
+#include "Descriptors/ThreadDescriptorCache.h"
+#include "../Application.h"
+#include "../Globals/Helpers.h"
+
+ParallelRecordingContext::ParallelRecordingContext(std::shared_ptr<CommandQueue> commandQueue, uint32_t numSlots)
+	: m_CommandQueue(std::move(commandQueue))
+	, m_CommandListType(m_CommandQueue->GetCommandListType())
+	, m_Slots(std::max(numSlots, 1u))
+	, m_Record(nullptr)
+	, m_Generation(0)
+	, m_NumPending(0)
+	, m_Shutdown(false)
+{
+	for (uint32_t slot = 1; slot < m_Slots.size(); ++slot)
+	{
+		m_Workers.emplace_back(&ParallelRecordingContext::WorkerThread, this, slot);
+	}
+}
+
+ParallelRecordingContext::~ParallelRecordingContext()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WorkMutex);
+		m_Shutdown = true;
+	}
+
+	m_WorkReady.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+
+	// Allocators still in flight can't be released until the GPU is done.
+	uint64_t lastFenceValue = 0;
+	for (auto& slot : m_Slots)
+	{
+		if (!slot.Allocators.empty())
+		{
+			lastFenceValue = std::max(lastFenceValue, slot.Allocators.back().FenceValue);
+		}
+	}
+
+	m_CommandQueue->WaitForFenceValue(lastFenceValue);
+}
+
+ComPtr<ID3D12GraphicsCommandList2> ParallelRecordingContext::Begin(uint32_t slotIndex)
+{
+	auto& slot = m_Slots[slotIndex];
+	if (slot.IsOpen)
+	{
+		return slot.CommandList;
+	}
+
+	auto device = Application::Get().GetDevice();
+
+	if (!slot.Allocators.empty() && m_CommandQueue->IsFenceComplete(slot.Allocators.front().FenceValue))
+	{
+		slot.CurrentAllocator = slot.Allocators.front().Allocator;
+		slot.Allocators.pop();
+
+		ThrowIfFailed(slot.CurrentAllocator->Reset());
+	}
+	else
+	{
+		ThrowIfFailed(device->CreateCommandAllocator(m_CommandListType, IID_PPV_ARGS(&slot.CurrentAllocator)));
+	}
+
+	if (slot.CommandList)
+	{
+		ThrowIfFailed(slot.CommandList->Reset(slot.CurrentAllocator.Get(), nullptr));
+	}
+	else
+	{
+		ThrowIfFailed(device->CreateCommandList(0, m_CommandListType, slot.CurrentAllocator.Get(), nullptr, IID_PPV_ARGS(&slot.CommandList)));
+	}
+
+	slot.IsOpen = true;
+	return slot.CommandList;
+}
+
+void ParallelRecordingContext::Record(const std::function<void(uint32_t slot, ID3D12GraphicsCommandList2* commandList)>& record)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WorkMutex);
+		m_Record = &record;
+		m_NumPending = static_cast<uint32_t>(m_Workers.size());
+		m_Exception = nullptr;
+		++m_Generation;
+	}
+
+	m_WorkReady.notify_all();
+
+	RunSlot(0);
+
+	std::unique_lock<std::mutex> lock(m_WorkMutex);
+	m_WorkDone.wait(lock, [this] { return m_NumPending == 0; });
+	m_Record = nullptr;
+
+	if (m_Exception)
+	{
+		std::rethrow_exception(m_Exception);
+	}
+}
+
+uint64_t ParallelRecordingContext::Submit()
+{
+	std::vector<ID3D12CommandList*> commandLists;
+	commandLists.reserve(m_Slots.size());
+
+	for (auto& slot : m_Slots)
+	{
+		if (slot.IsOpen)
+		{
+			ThrowIfFailed(slot.CommandList->Close());
+			commandLists.push_back(slot.CommandList.Get());
+		}
+	}
+
+	if (commandLists.empty())
+	{
+		return m_CommandQueue->GetLastSignalledFenceValue();
+	}
+
+	uint64_t fenceValue = m_CommandQueue->Submit(commandLists.data(), static_cast<UINT>(commandLists.size()));
+
+	for (auto& slot : m_Slots)
+	{
+		if (slot.IsOpen)
+		{
+			slot.Allocators.push({ fenceValue, std::move(slot.CurrentAllocator) });
+			slot.IsOpen = false;
+		}
+	}
+
+	return fenceValue;
+}
+
+void ParallelRecordingContext::WorkerThread(uint32_t slot)
+{
+	uint64_t generation = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_WorkMutex);
+			m_WorkReady.wait(lock, [this, generation] { return m_Shutdown || m_Generation != generation; });
+
+			if (m_Shutdown)
+			{
+				break;
+			}
+
+			generation = m_Generation;
+		}
+
+		RunSlot(slot);
+
+		{
+			std::lock_guard<std::mutex> lock(m_WorkMutex);
+			--m_NumPending;
+		}
+
+		m_WorkDone.notify_one();
+	}
+
+	ThreadDescriptorCache::Flush();
+}
+
+void ParallelRecordingContext::RunSlot(uint32_t slot)
+{
+	try
+	{
+		auto commandList = Begin(slot);
+		(*m_Record)(slot, commandList.Get());
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_WorkMutex);
+		if (!m_Exception)
+		{
+			m_Exception = std::current_exception();
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "../Globals/stdafx.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class CommandQueue;
+
+// Records one submission's command lists on several threads. Every slot has
+// its own command list and fence-recycled allocator pool, so recording never
+// touches the queue's shared pools, and Submit sends the lists in slot order
+// through a single ExecuteCommandLists call.
+class ParallelRecordingContext
+{
+public:
+	ParallelRecordingContext(std::shared_ptr<CommandQueue> commandQueue, uint32_t numSlots = std::thread::hardware_concurrency());
+	virtual ~ParallelRecordingContext();
+
+	uint32_t GetNumSlots() const { return static_cast<uint32_t>(m_Slots.size()); }
+
+	// Opens the slot's command list. A slot must only be used by one thread
+	// between Begin and Submit.
+	ComPtr<ID3D12GraphicsCommandList2> Begin(uint32_t slot);
+
+	// Runs record once per slot, slot 0 on the calling thread and the rest on
+	// the context's workers, and returns when all are done. The first exception
+	// thrown by any of them is rethrown here.
+	void Record(const std::function<void(uint32_t slot, ID3D12GraphicsCommandList2* commandList)>& record);
+
+	// Closes every opened list, submits them in slot order and returns the
+	// fence value that marks their completion.
+	uint64_t Submit();
+
+private:
+	struct AllocatorEntry
+	{
+		uint64_t FenceValue;
+		ComPtr<ID3D12CommandAllocator> Allocator;
+	};
+
+	struct Slot
+	{
+		std::queue<AllocatorEntry> Allocators;
+		ComPtr<ID3D12CommandAllocator> CurrentAllocator;
+		ComPtr<ID3D12GraphicsCommandList2> CommandList;
+		bool IsOpen = false;
+	};
+
+	void WorkerThread(uint32_t slot);
+	void RunSlot(uint32_t slot);
+
+	std::shared_ptr<CommandQueue> m_CommandQueue;
+	D3D12_COMMAND_LIST_TYPE m_CommandListType;
+
+	std::vector<Slot> m_Slots;
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_WorkMutex;
+	std::condition_variable m_WorkReady;
+	std::condition_variable m_WorkDone;
+	const std::function<void(uint32_t, ID3D12GraphicsCommandList2*)>* m_Record;
+	uint64_t m_Generation;
+	uint32_t m_NumPending;
+	std::exception_ptr m_Exception;
+	bool m_Shutdown;
+};
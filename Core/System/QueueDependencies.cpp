@@ -0,0 +1,34 @@
+#include "QueueDependencies.h"
+#include "CommandQueue.h"
+
+void QueueDependencies::Add(const CommandQueue& producer, uint64_t fenceValue)
+{
+	for (auto& dependency : m_Dependencies)
+	{
+		if (dependency.first == &producer)
+		{
+			dependency.second = std::max(dependency.second, fenceValue);
+			return;
+		}
+	}
+
+	m_Dependencies.emplace_back(&producer, fenceValue);
+}
+
+void QueueDependencies::Merge(const QueueDependencies& other)
+{
+	for (const auto& dependency : other.m_Dependencies)
+	{
+		Add(*dependency.first, dependency.second);
+	}
+}
+
+void QueueDependencies::Apply(CommandQueue& consumer)
+{
+	for (const auto& dependency : m_Dependencies)
+	{
+		consumer.Wait(*dependency.first, dependency.second);
+	}
+
+	m_Dependencies.clear();
+}
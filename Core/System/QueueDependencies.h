@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class CommandQueue;
+
+// Collects the work on other queues that a submission depends on, keeping only
+// the latest fence value per queue, and turns it into GPU-side waits.
+class QueueDependencies
+{
+public:
+	void Add(const CommandQueue& producer, uint64_t fenceValue);
+	void Merge(const QueueDependencies& other);
+
+	// Makes consumer wait on every producer, then clears the set. Dependencies
+	// on consumer itself are dropped since a queue runs its work in order.
+	void Apply(CommandQueue& consumer);
+
+	bool IsEmpty() const { return m_Dependencies.empty(); }
+	void Clear() { m_Dependencies.clear(); }
+
+private:
+	std::vector<std::pair<const CommandQueue*, uint64_t>> m_Dependencies;
+};
@@ -0,0 +1,262 @@
+#include "ResourceStateTracker.h"
+#include "../Globals/d3dx12.h"
+
+ResourceStateTracker::ResourceStateMap ResourceStateTracker::s_GlobalResourceState;
+std::mutex ResourceStateTracker::s_GlobalMutex;
+
+// Marks subresources a list hasn't used yet, whose state is only known once
+// the list is submitted.
+static const D3D12_RESOURCE_STATES UnknownState = static_cast<D3D12_RESOURCE_STATES>(-1);
+
+static UINT GetNumSubresources(ID3D12Resource* resource)
+{
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		return 1;
+	}
+
+	UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+	return desc.MipLevels * arraySize;
+}
+
+void ResourceStateTracker::ResourceState::SetSubresourceState(UINT subresource, D3D12_RESOURCE_STATES state)
+{
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		State = state;
+		SubresourceStates.clear();
+	}
+	else
+	{
+		SubresourceStates[subresource] = state;
+	}
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::ResourceState::GetSubresourceState(UINT subresource) const
+{
+	auto it = SubresourceStates.find(subresource);
+	return it != SubresourceStates.end() ? it->second : State;
+}
+
+ResourceStateTracker::ResourceStateTracker()
+	: m_Statistics()
+{}
+
+ResourceStateTracker::~ResourceStateTracker()
+{}
+
+void ResourceStateTracker::TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter, UINT subresource)
+{
+	auto it = m_FinalResourceState.find(resource);
+	if (it == m_FinalResourceState.end())
+	{
+		it = m_FinalResourceState.emplace(resource, ResourceState(UnknownState)).first;
+	}
+
+	auto& known = it->second;
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && !known.SubresourceStates.empty())
+	{
+		UINT numSubresources = GetNumSubresources(resource);
+		for (UINT i = 0; i < numSubresources; ++i)
+		{
+			QueueTransition(resource, i, known.GetSubresourceState(i), stateAfter);
+		}
+	}
+	else
+	{
+		QueueTransition(resource, subresource, known.GetSubresourceState(subresource), stateAfter);
+	}
+
+	known.SetSubresourceState(subresource, stateAfter);
+}
+
+void ResourceStateTracker::QueueTransition(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+{
+	if (stateBefore == UnknownState)
+	{
+		// First use on this list; the before state is only known at submit.
+		m_PendingResourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATE_COMMON, stateAfter, subresource));
+		return;
+	}
+
+	if (stateBefore == stateAfter)
+	{
+		++m_Statistics.NumRedundantTransitions;
+		return;
+	}
+
+	// Nothing runs between queued barriers, so a transition still waiting to
+	// be flushed can be retargeted, unless another barrier on the resource
+	// was queued after it.
+	for (auto it = m_ResourceBarriers.rbegin(); it != m_ResourceBarriers.rend(); ++it)
+	{
+		auto& barrier = *it;
+		bool isTransition = barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+
+		if (isTransition && barrier.Transition.pResource == resource && barrier.Transition.Subresource == subresource)
+		{
+			++m_Statistics.NumRedundantTransitions;
+
+			if (barrier.Transition.StateBefore == stateAfter)
+			{
+				m_ResourceBarriers.erase(std::next(it).base());
+			}
+			else
+			{
+				barrier.Transition.StateAfter = stateAfter;
+			}
+
+			return;
+		}
+
+		if ((isTransition && barrier.Transition.pResource == resource) ||
+			(barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV && (barrier.UAV.pResource == resource || !barrier.UAV.pResource)) ||
+			barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+		{
+			break;
+		}
+	}
+
+	m_ResourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, stateBefore, stateAfter, subresource));
+}
+
+void ResourceStateTracker::UAVBarrier(ID3D12Resource* resource)
+{
+	m_ResourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+}
+
+void ResourceStateTracker::AliasBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter)
+{
+	m_ResourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(resourceBefore, resourceAfter));
+}
+
+uint32_t ResourceStateTracker::FlushResourceBarriers(ID3D12GraphicsCommandList* commandList)
+{
+	uint32_t numBarriers = static_cast<uint32_t>(m_ResourceBarriers.size());
+	if (numBarriers > 0)
+	{
+		commandList->ResourceBarrier(numBarriers, m_ResourceBarriers.data());
+		m_ResourceBarriers.clear();
+
+		++m_Statistics.NumBarrierCalls;
+		m_Statistics.NumBarriers += numBarriers;
+	}
+
+	return numBarriers;
+}
+
+void ResourceStateTracker::AppendTransitions(std::vector<D3D12_RESOURCE_BARRIER>& barriers, ID3D12Resource* resource, const ResourceState& known, D3D12_RESOURCE_STATES stateAfter, UINT subresource)
+{
+	if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && !known.SubresourceStates.empty())
+	{
+		UINT numSubresources = GetNumSubresources(resource);
+		for (UINT i = 0; i < numSubresources; ++i)
+		{
+			D3D12_RESOURCE_STATES stateBefore = known.GetSubresourceState(i);
+			if (stateBefore != stateAfter)
+			{
+				barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, stateBefore, stateAfter, i));
+			}
+		}
+	}
+	else
+	{
+		D3D12_RESOURCE_STATES stateBefore = known.GetSubresourceState(subresource);
+		if (stateBefore != stateAfter)
+		{
+			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, stateBefore, stateAfter, subresource));
+		}
+	}
+}
+
+uint32_t ResourceStateTracker::ResolvePendingResourceBarriers()
+{
+	for (const auto& pendingBarrier : m_PendingResourceBarriers)
+	{
+		const auto& transition = pendingBarrier.Transition;
+
+		// Resources nobody registered are assumed to be in the common state.
+		auto it = s_GlobalResourceState.find(transition.pResource);
+		const ResourceState& known = it != s_GlobalResourceState.end() ? it->second : ResourceState();
+
+		size_t numBefore = m_ResolvedResourceBarriers.size();
+		AppendTransitions(m_ResolvedResourceBarriers, transition.pResource, known, transition.StateAfter, transition.Subresource);
+
+		if (m_ResolvedResourceBarriers.size() == numBefore)
+		{
+			++m_Statistics.NumRedundantTransitions;
+		}
+	}
+
+	m_PendingResourceBarriers.clear();
+
+	return static_cast<uint32_t>(m_ResolvedResourceBarriers.size());
+}
+
+uint32_t ResourceStateTracker::FlushPendingResourceBarriers(ID3D12GraphicsCommandList* commandList)
+{
+	uint32_t numBarriers = ResolvePendingResourceBarriers();
+	if (numBarriers > 0)
+	{
+		commandList->ResourceBarrier(numBarriers, m_ResolvedResourceBarriers.data());
+		m_ResolvedResourceBarriers.clear();
+
+		++m_Statistics.NumBarrierCalls;
+		m_Statistics.NumBarriers += numBarriers;
+	}
+
+	return numBarriers;
+}
+
+void ResourceStateTracker::CommitFinalResourceStates()
+{
+	for (const auto& finalState : m_FinalResourceState)
+	{
+		auto& globalState = s_GlobalResourceState[finalState.first];
+
+		// Subresources the list never used keep their global state.
+		if (finalState.second.State != UnknownState)
+		{
+			globalState.SetSubresourceState(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, finalState.second.State);
+		}
+
+		for (const auto& subresourceState : finalState.second.SubresourceStates)
+		{
+			globalState.SetSubresourceState(subresourceState.first, subresourceState.second);
+		}
+	}
+
+	m_FinalResourceState.clear();
+}
+
+void ResourceStateTracker::Reset()
+{
+	m_ResourceBarriers.clear();
+	m_PendingResourceBarriers.clear();
+	m_ResolvedResourceBarriers.clear();
+	m_FinalResourceState.clear();
+}
+
+std::unique_lock<std::mutex> ResourceStateTracker::LockGlobalStates()
+{
+	return std::unique_lock<std::mutex>(s_GlobalMutex);
+}
+
+void ResourceStateTracker::AddGlobalResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+{
+	if (resource)
+	{
+		std::lock_guard<std::mutex> lock(s_GlobalMutex);
+		s_GlobalResourceState[resource].SetSubresourceState(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, state);
+	}
+}
+
+void ResourceStateTracker::RemoveGlobalResourceState(ID3D12Resource* resource)
+{
+	if (resource)
+	{
+		std::lock_guard<std::mutex> lock(s_GlobalMutex);
+		s_GlobalResourceState.erase(resource);
+	}
+}
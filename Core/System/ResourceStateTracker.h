@@ -0,0 +1,101 @@
+#pragma once
+#include "../Globals/stdafx.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Tracks resource states while one command list is recorded. Transitions only
+// name the state a resource needs; the before state comes from earlier
+// transitions on the same list, or for a resource's first use on the list
+// from the global state when the list is submitted. Barriers are queued and
+// issued together by FlushResourceBarriers, which should be called right
+// before draws, dispatches, copies and clears.
+class ResourceStateTracker
+{
+public:
+	ResourceStateTracker();
+	virtual ~ResourceStateTracker();
+
+	// Transitions that don't change the state are dropped, and a transition
+	// that undoes one still queued cancels it.
+	void TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter,
+		UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+	void UAVBarrier(ID3D12Resource* resource = nullptr);
+	void AliasBarrier(ID3D12Resource* resourceBefore = nullptr, ID3D12Resource* resourceAfter = nullptr);
+
+	// Issues every queued barrier with one ResourceBarrier call and returns
+	// how many there were.
+	uint32_t FlushResourceBarriers(ID3D12GraphicsCommandList* commandList);
+
+	bool HasPendingResourceBarriers() const { return !m_PendingResourceBarriers.empty(); }
+
+	// Resolves the first-use transitions against the global states and returns
+	// how many barriers are still needed, so callers can skip recording a list
+	// for them when there are none. Call with the global lock held.
+	uint32_t ResolvePendingResourceBarriers();
+
+	// Resolves any remaining first-use transitions and records the needed
+	// barriers into commandList, which must run just before this tracker's
+	// list. Call with the global lock held.
+	uint32_t FlushPendingResourceBarriers(ID3D12GraphicsCommandList* commandList);
+
+	// Writes the states the list leaves its resources in back to the global
+	// states. Call with the global lock held.
+	void CommitFinalResourceStates();
+
+	void Reset();
+
+	struct Statistics
+	{
+		uint64_t NumBarrierCalls;
+		uint64_t NumBarriers;
+		uint64_t NumRedundantTransitions;
+	};
+
+	Statistics GetStatistics() const { return m_Statistics; }
+
+	// Held while pending barriers are resolved, final states committed and the
+	// lists submitted, so submissions see each other's states in order.
+	static std::unique_lock<std::mutex> LockGlobalStates();
+
+	static void AddGlobalResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+	static void RemoveGlobalResourceState(ID3D12Resource* resource);
+
+private:
+	struct ResourceState
+	{
+		explicit ResourceState(D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON)
+			: State(state)
+		{}
+
+		void SetSubresourceState(UINT subresource, D3D12_RESOURCE_STATES state);
+		D3D12_RESOURCE_STATES GetSubresourceState(UINT subresource) const;
+
+		// Subresources not in the map are in State. In a list's final states,
+		// State is unknown until the list transitions every subresource.
+		D3D12_RESOURCE_STATES State;
+		std::map<UINT, D3D12_RESOURCE_STATES> SubresourceStates;
+	};
+
+	typedef std::unordered_map<ID3D12Resource*, ResourceState> ResourceStateMap;
+
+	// Appends the barriers that move a resource from known to stateAfter.
+	static void AppendTransitions(std::vector<D3D12_RESOURCE_BARRIER>& barriers, ID3D12Resource* resource,
+		const ResourceState& known, D3D12_RESOURCE_STATES stateAfter, UINT subresource);
+
+	void QueueTransition(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter);
+
+	std::vector<D3D12_RESOURCE_BARRIER> m_ResourceBarriers;
+	std::vector<D3D12_RESOURCE_BARRIER> m_PendingResourceBarriers;
+	std::vector<D3D12_RESOURCE_BARRIER> m_ResolvedResourceBarriers;
+	ResourceStateMap m_FinalResourceState;
+
+	Statistics m_Statistics;
+
+	static ResourceStateMap s_GlobalResourceState;
+	static std::mutex s_GlobalMutex;
+};
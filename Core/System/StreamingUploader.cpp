@@ -0,0 +1,178 @@
+#include "StreamingUploader.h"
+#include "CommandQueue.h"
+#include "WriteCombinedMemory.h"
+#include "../Application.h"
+#include "../Globals/d3dx12.h"
+
+// Keeps ring offsets friendly to the streaming copy kernel.
+static constexpr size_t RingAlignment = 16;
+
+StreamingUploader::StreamingUploader(std::shared_ptr<CommandQueue> copyQueue, size_t ringSize, size_t chunkSize)
+	: m_CopyQueue(std::move(copyQueue))
+	, m_RingData(nullptr)
+	, m_RingSize(ringSize)
+	, m_ChunkSize(std::min(chunkSize, ringSize))
+	, m_Head(0)
+	, m_Tail(0)
+	, m_PendingBytes(0)
+	, m_LastFenceValue(0)
+{
+	auto device = Application::Get().GetDevice();
+
+	const CD3DX12_HEAP_PROPERTIES UploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+	const CD3DX12_RESOURCE_DESC RingBuffer(CD3DX12_RESOURCE_DESC::Buffer(m_RingSize));
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&UploadHeapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&RingBuffer,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_RingBuffer)));
+	++m_Statistics.StagingResourcesCreated;
+
+	ThrowIfFailed(m_RingBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_RingData)));
+	WriteCombined::RegisterMappedRange(m_RingData, m_RingSize);
+}
+
+StreamingUploader::~StreamingUploader()
+{
+	// The ring can't be released while copies out of it are still running.
+	m_CopyQueue->WaitForFenceValue(Submit());
+
+	WriteCombined::UnregisterMappedRange(m_RingData);
+	m_RingBuffer->Unmap(0, nullptr);
+}
+
+void StreamingUploader::UploadBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, size_t sizeInBytes)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto source = static_cast<const uint8_t*>(data);
+
+	while (sizeInBytes > 0)
+	{
+		size_t pieceSize = std::min(sizeInBytes, m_ChunkSize);
+		size_t offset = ReserveSpace(pieceSize);
+
+		WriteCombined::Copy(m_RingData + offset, source, pieceSize);
+
+		if (!m_CommandList)
+		{
+			m_CommandList = m_CopyQueue->GetCommandList();
+		}
+
+		m_CommandList->CopyBufferRegion(destination, destinationOffset, m_RingBuffer.Get(), offset, pieceSize);
+
+		++m_Statistics.CopiesRecorded;
+		m_Statistics.BytesUploaded += pieceSize;
+
+		if (m_PendingBytes >= m_ChunkSize)
+		{
+			SubmitPending();
+		}
+
+		source += pieceSize;
+		destinationOffset += pieceSize;
+		sizeInBytes -= pieceSize;
+	}
+}
+
+uint64_t StreamingUploader::Submit()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	SubmitPending();
+	return m_LastFenceValue;
+}
+
+size_t StreamingUploader::ReserveSpace(size_t sizeInBytes)
+{
+	sizeInBytes = Math::AlignUp(sizeInBytes, RingAlignment);
+	RetireCompletedChunks();
+
+	size_t offset;
+	while (!TryReserve(sizeInBytes, offset))
+	{
+		// Space only comes back from submitted work, so hand the GPU what has
+		// been recorded before waiting on anything.
+		if (m_PendingBytes > 0)
+		{
+			SubmitPending();
+			continue;
+		}
+
+		assert(!m_InFlightChunks.empty());
+
+		++m_Statistics.Stalls;
+		m_CopyQueue->WaitForFenceValue(m_InFlightChunks.front().FenceValue);
+		RetireCompletedChunks();
+	}
+
+	m_PendingBytes += sizeInBytes;
+	return offset;
+}
+
+bool StreamingUploader::TryReserve(size_t sizeInBytes, size_t& offset)
+{
+	bool isEmpty = m_InFlightChunks.empty() && m_PendingBytes == 0;
+	if (isEmpty)
+	{
+		m_Head = 0;
+		m_Tail = 0;
+	}
+
+	if (isEmpty || m_Head > m_Tail)
+	{
+		// Free space runs from the head to the end, then wraps round to the tail.
+		if (m_Head + sizeInBytes <= m_RingSize)
+		{
+			offset = m_Head;
+			m_Head += sizeInBytes;
+			return true;
+		}
+
+		if (sizeInBytes <= m_Tail)
+		{
+			offset = 0;
+			m_Head = sizeInBytes;
+			return true;
+		}
+
+		return false;
+	}
+
+	if (m_Head < m_Tail && m_Head + sizeInBytes <= m_Tail)
+	{
+		offset = m_Head;
+		m_Head += sizeInBytes;
+		return true;
+	}
+
+	return false;
+}
+
+void StreamingUploader::SubmitPending()
+{
+	if (m_PendingBytes == 0)
+	{
+		return;
+	}
+
+	m_LastFenceValue = m_CopyQueue->ExecuteCommandList(m_CommandList);
+	m_CommandList.Reset();
+
+	m_InFlightChunks.push_back({ m_LastFenceValue, m_Head });
+	m_PendingBytes = 0;
+
+	++m_Statistics.Submissions;
+}
+
+void StreamingUploader::RetireCompletedChunks()
+{
+	while (!m_InFlightChunks.empty() && m_CopyQueue->IsFenceComplete(m_InFlightChunks.front().FenceValue))
+	{
+		m_Tail = m_InFlightChunks.front().RingEnd;
+		m_InFlightChunks.pop_front();
+	}
+}
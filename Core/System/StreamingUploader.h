@@ -0,0 +1,73 @@
+#pragma once
+#include "../Globals/stdafx.h"
+#include "../Globals/Helpers.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+class CommandQueue;
+
+// Streams buffer data to default heap resources through one persistent,
+// mapped staging ring on the copy queue. Data is copied in chunks and each
+// full chunk is submitted straight away, so the GPU copies one chunk while the
+// CPU fills the next. Ring space is reclaimed as the queue's fence passes each
+// chunk; the CPU only waits when the whole ring is still in flight.
+class StreamingUploader
+{
+public:
+	struct Statistics
+	{
+		uint64_t BytesUploaded = 0;
+		uint64_t CopiesRecorded = 0;
+		uint64_t Submissions = 0;
+		uint64_t Stalls = 0;
+		uint64_t StagingResourcesCreated = 0;
+	};
+
+	StreamingUploader(std::shared_ptr<CommandQueue> copyQueue, size_t ringSize = _16MB, size_t chunkSize = _2MB);
+	virtual ~StreamingUploader();
+
+	// Queues a copy of sizeInBytes of data into destination. The destination
+	// must stay alive, and must not be read, until the fence returned by a
+	// later Submit has completed.
+	void UploadBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, size_t sizeInBytes);
+
+	// Submits everything recorded so far and returns the copy queue fence
+	// value that covers every upload queued up to this point.
+	uint64_t Submit();
+
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	struct InFlightChunk
+	{
+		uint64_t FenceValue;
+		size_t RingEnd;
+	};
+
+	size_t ReserveSpace(size_t sizeInBytes);
+	bool TryReserve(size_t sizeInBytes, size_t& offset);
+	void SubmitPending();
+	void RetireCompletedChunks();
+
+	std::shared_ptr<CommandQueue> m_CopyQueue;
+	ComPtr<ID3D12GraphicsCommandList2> m_CommandList;
+
+	ComPtr<ID3D12Resource> m_RingBuffer;
+	uint8_t* m_RingData;
+	size_t m_RingSize;
+	size_t m_ChunkSize;
+
+	// Bytes in [m_Tail, m_Head) are in use, wrapping at m_RingSize.
+	size_t m_Head;
+	size_t m_Tail;
+	size_t m_PendingBytes;
+	uint64_t m_LastFenceValue;
+
+	std::deque<InFlightChunk> m_InFlightChunks;
+	Statistics m_Statistics;
+
+	std::mutex m_Mutex;
+};
@@ -0,0 +1,248 @@
+#include "TLSFFreeList.h"
+
+#include <algorithm>
+#include <cassert>
+#include <intrin.h>
+
+static uint32_t FloorLog2(uint32_t value)
+{
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return static_cast<uint32_t>(index);
+}
+
+static uint32_t LowestSetBit(uint32_t value)
+{
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return static_cast<uint32_t>(index);
+}
+
+TLSFFreeList::TLSFFreeList(uint32_t capacity)
+	: m_Capacity(capacity)
+	, m_Blocks(capacity)
+	, m_EndTags(capacity, InvalidOffset)
+	, m_FirstLevelMask(0)
+	, m_SecondLevelMasks{}
+{
+	for (auto& heads : m_FreeHeads)
+	{
+		std::fill(std::begin(heads), std::end(heads), InvalidOffset);
+	}
+
+	if (m_Capacity > 0)
+	{
+		InsertBlock(0, m_Capacity);
+	}
+}
+
+uint32_t TLSFFreeList::Allocate(uint32_t size)
+{
+	if (size == 0)
+	{
+		return InvalidOffset;
+	}
+
+	uint32_t offset = FindFreeBlock(size);
+	if (offset == InvalidOffset)
+	{
+		return InvalidOffset;
+	}
+
+	uint32_t blockSize = m_Blocks[offset].Size;
+	RemoveBlock(offset);
+
+	if (blockSize > size)
+	{
+		InsertBlock(offset + size, blockSize - size);
+	}
+
+	return offset;
+}
+
+void TLSFFreeList::Free(uint32_t offset, uint32_t size)
+{
+	assert(size > 0 && offset + size <= m_Capacity);
+
+	if (offset > 0)
+	{
+		uint32_t prevOffset = m_EndTags[offset - 1];
+		if (prevOffset != InvalidOffset && m_Blocks[prevOffset].IsFree &&
+			prevOffset + m_Blocks[prevOffset].Size == offset)
+		{
+			size += m_Blocks[prevOffset].Size;
+			offset = prevOffset;
+			RemoveBlock(prevOffset);
+		}
+	}
+
+	uint32_t nextOffset = offset + size;
+	if (nextOffset < m_Capacity && m_Blocks[nextOffset].IsFree)
+	{
+		size += m_Blocks[nextOffset].Size;
+		RemoveBlock(nextOffset);
+	}
+
+	InsertBlock(offset, size);
+}
+
+bool TLSFFreeList::HasSpace(uint32_t size) const
+{
+	return FindFreeBlock(size) != InvalidOffset;
+}
+
+uint32_t TLSFFreeList::LargestFreeBlock() const
+{
+	if (m_FirstLevelMask == 0)
+	{
+		return 0;
+	}
+
+	uint32_t firstLevel = FloorLog2(m_FirstLevelMask);
+	uint32_t secondLevel = FloorLog2(m_SecondLevelMasks[firstLevel]);
+
+	return m_Blocks[m_FreeHeads[firstLevel][secondLevel]].Size;
+}
+
+void TLSFFreeList::MapSize(uint32_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+	if (size < SecondLevelCount)
+	{
+		firstLevel = 0;
+		secondLevel = size;
+	}
+	else
+	{
+		uint32_t log2 = FloorLog2(size);
+		firstLevel = log2 - SecondLevelBits + 1;
+		secondLevel = (size >> (log2 - SecondLevelBits)) - SecondLevelCount;
+	}
+}
+
+uint32_t TLSFFreeList::FindFreeBlock(uint32_t size) const
+{
+	if (size == 0)
+	{
+		return InvalidOffset;
+	}
+
+	// Round the request up to the start of the next class so that any block in
+	// the class found is large enough.
+	uint64_t roundedSize = size;
+	if (size >= SecondLevelCount)
+	{
+		roundedSize += (1ull << (FloorLog2(size) - SecondLevelBits)) - 1;
+	}
+
+	if (roundedSize <= UINT32_MAX)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize(static_cast<uint32_t>(roundedSize), firstLevel, secondLevel);
+
+		uint32_t secondLevelMask = m_SecondLevelMasks[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMask == 0)
+		{
+			uint32_t firstLevelMask = firstLevel + 1 < 32 ? m_FirstLevelMask & (~0u << (firstLevel + 1)) : 0;
+			if (firstLevelMask != 0)
+			{
+				firstLevel = LowestSetBit(firstLevelMask);
+				secondLevelMask = m_SecondLevelMasks[firstLevel];
+			}
+		}
+
+		if (secondLevelMask != 0)
+		{
+			return m_FreeHeads[firstLevel][LowestSetBit(secondLevelMask)];
+		}
+	}
+
+	// Nothing in the rounded-up classes; the head of the request's own class,
+	// which is the largest block inserted there lately, may still fit.
+	uint32_t firstLevel, secondLevel;
+	MapSize(size, firstLevel, secondLevel);
+
+	uint32_t offset = m_FreeHeads[firstLevel][secondLevel];
+	if (offset != InvalidOffset && m_Blocks[offset].Size >= size)
+	{
+		return offset;
+	}
+
+	return InvalidOffset;
+}
+
+void TLSFFreeList::InsertBlock(uint32_t offset, uint32_t size)
+{
+	uint32_t firstLevel, secondLevel;
+	MapSize(size, firstLevel, secondLevel);
+
+	auto& block = m_Blocks[offset];
+	block.Size = size;
+	block.IsFree = true;
+
+	// Keep the larger block at the head so the head check in FindFreeBlock and
+	// LargestFreeBlock see it.
+	uint32_t head = m_FreeHeads[firstLevel][secondLevel];
+	if (head != InvalidOffset && m_Blocks[head].Size > size)
+	{
+		block.PrevFree = head;
+		block.NextFree = m_Blocks[head].NextFree;
+		if (block.NextFree != InvalidOffset)
+		{
+			m_Blocks[block.NextFree].PrevFree = offset;
+		}
+
+		m_Blocks[head].NextFree = offset;
+	}
+	else
+	{
+		block.PrevFree = InvalidOffset;
+		block.NextFree = head;
+		if (head != InvalidOffset)
+		{
+			m_Blocks[head].PrevFree = offset;
+		}
+
+		m_FreeHeads[firstLevel][secondLevel] = offset;
+	}
+
+	m_FirstLevelMask |= 1u << firstLevel;
+	m_SecondLevelMasks[firstLevel] |= 1u << secondLevel;
+
+	m_EndTags[offset + size - 1] = offset;
+}
+
+void TLSFFreeList::RemoveBlock(uint32_t offset)
+{
+	auto& block = m_Blocks[offset];
+	assert(block.IsFree);
+
+	uint32_t firstLevel, secondLevel;
+	MapSize(block.Size, firstLevel, secondLevel);
+
+	if (block.PrevFree != InvalidOffset)
+	{
+		m_Blocks[block.PrevFree].NextFree = block.NextFree;
+	}
+	else
+	{
+		m_FreeHeads[firstLevel][secondLevel] = block.NextFree;
+	}
+
+	if (block.NextFree != InvalidOffset)
+	{
+		m_Blocks[block.NextFree].PrevFree = block.PrevFree;
+	}
+
+	if (m_FreeHeads[firstLevel][secondLevel] == InvalidOffset)
+	{
+		m_SecondLevelMasks[firstLevel] &= ~(1u << secondLevel);
+		if (m_SecondLevelMasks[firstLevel] == 0)
+		{
+			m_FirstLevelMask &= ~(1u << firstLevel);
+		}
+	}
+
+	block.IsFree = false;
+	block.NextFree = InvalidOffset;
+	block.PrevFree = InvalidOffset;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit free list over a fixed range of [0, capacity) slots.
+// Block headers live in a flat array indexed by offset, so allocating and
+// freeing never touch the heap. Only free blocks are tracked, which lets any
+// sub-range of an allocation be freed independently, and freed ranges are
+// merged with free neighbours on both sides.
+//
+// Every query only looks at bitmaps and list heads, so it runs in constant
+// time. Sizes below 16 are exact; above that a class spans 1/16 of its size
+// and only its head is checked, so a request may miss a slightly larger block
+// further down the same class.
+class TLSFFreeList
+{
+public:
+	static constexpr uint32_t InvalidOffset = ~0u;
+
+	explicit TLSFFreeList(uint32_t capacity);
+
+	uint32_t Allocate(uint32_t size);
+	void Free(uint32_t offset, uint32_t size);
+
+	// HasSpace(size) is true exactly when size <= LargestFreeBlock(), which may
+	// understate the true largest block by less than one class.
+	bool HasSpace(uint32_t size) const;
+	uint32_t LargestFreeBlock() const;
+
+private:
+	static constexpr uint32_t SecondLevelBits = 4;
+	static constexpr uint32_t SecondLevelCount = 1u << SecondLevelBits;
+	static constexpr uint32_t FirstLevelCount = 32 - SecondLevelBits + 1;
+
+	struct BlockHeader
+	{
+		uint32_t Size = 0;
+		uint32_t NextFree = InvalidOffset;
+		uint32_t PrevFree = InvalidOffset;
+		bool IsFree = false;
+	};
+
+	static void MapSize(uint32_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+	uint32_t FindFreeBlock(uint32_t size) const;
+
+	void InsertBlock(uint32_t offset, uint32_t size);
+	void RemoveBlock(uint32_t offset);
+
+	uint32_t m_Capacity;
+
+	std::vector<BlockHeader> m_Blocks;
+	std::vector<uint32_t> m_EndTags;
+
+	uint32_t m_FirstLevelMask;
+	uint32_t m_SecondLevelMasks[FirstLevelCount];
+	uint32_t m_FreeHeads[FirstLevelCount][SecondLevelCount];
+};
@@ -2,10 +2,30 @@
 #include "../Application.h"
 #include "../Globals/Helpers.h"
 #include "../Globals/d3dx12.h"
+#include <intrin.h>
 #include <new>
 
-UploadBuffer::UploadBuffer(size_t pageSize)
-	: m_PageSize(pageSize)
+static uint32_t LargePageClass(size_t sizeInBytes)
+{
+	unsigned long index;
+	_BitScanReverse64(&index, static_cast<unsigned long long>(sizeInBytes - 1));
+	return static_cast<uint32_t>(index) + 1;
+}
+
+UploadBuffer::UploadBuffer(size_t pageSize, uint32_t maxIdleResets)
+	: m_NextAvailablePage(0)
+	, m_CurrentPage(nullptr)
+	, m_PageSize(pageSize)
+	, m_MaxIdleResets(maxIdleResets)
+{
+}
+
+UploadBuffer::UploadBuffer(size_t pageSize, uint32_t maxIdleResets, std::shared_ptr<SharedPagePool> sharedPages)
+	: m_NextAvailablePage(0)
+	, m_CurrentPage(nullptr)
+	, m_SharedPages(std::move(sharedPages))
+	, m_PageSize(pageSize)
+	, m_MaxIdleResets(maxIdleResets)
 {
 }
 
@@ -15,50 +35,189 @@ UploadBuffer::~UploadBuffer()
 
 UploadBuffer::Allocation UploadBuffer::Allocate(size_t sizeInBytes, size_t alignment)
 {
-	if (sizeInBytes > m_PageSize)
+	if (Math::AlignUp(sizeInBytes, alignment) > m_PageSize)
 	{
-		throw std::bad_alloc();
+		return AllocateLarge(sizeInBytes, alignment);
 	}
 
-	if (!m_CurrentPage || !m_CurrentPage->HasSpace(sizeInBytes, alignment))
+	Allocation allocation;
+	Page* page = m_CurrentPage.load(std::memory_order_acquire);
+
+	while (!page || !page->TryAllocate(sizeInBytes, alignment, allocation))
 	{
-		m_CurrentPage = RequestPage();
+		page = ReplaceCurrentPage(page);
 	}
 
-	return m_CurrentPage->Allocate(sizeInBytes, alignment);
+	return allocation;
+}
+
+UploadBuffer::Allocation UploadBuffer::Upload(const void* data, size_t sizeInBytes, size_t alignment)
+{
+	Allocation allocation = Allocate(sizeInBytes, alignment);
+	WriteCombined::Copy(allocation.CPU, data, sizeInBytes);
+	return allocation;
 }
 
 void UploadBuffer::Reset()
 {
-	m_CurrentPage = nullptr;
-	m_AvailablePages = m_PagePool;
+	std::lock_guard<std::mutex> lock(m_PageMutex);
 
-	for (auto page : m_AvailablePages)
+	m_CurrentPage.store(nullptr, std::memory_order_relaxed);
+	m_NextAvailablePage = 0;
+
+	m_Statistics.BytesUsed = 0;
+	m_Statistics.AlignmentWaste = 0;
+
+	// RetirePages below records and rewinds these along with the idle ones.
+	for (auto& page : m_LargePagesInUse)
+	{
+		m_AvailableLargePages[LargePageClass(page->GetPageSize())].push_back(std::move(page));
+	}
+
+	m_LargePagesInUse.clear();
+
+	m_Statistics.NumLargePages = 0;
+	for (auto& availablePages : m_AvailableLargePages)
 	{
+		m_Statistics.NumLargePages += RetirePages(availablePages);
+	}
+
+	for (auto& page : m_NewPages)
+	{
+		m_PagePool.push_back(std::move(page));
+	}
+
+	m_NewPages.clear();
+	m_Statistics.NumPages = RetirePages(m_PagePool);
+
+	if (m_SharedPages)
+	{
+		std::lock_guard<std::mutex> sharedLock(m_SharedPages->Mutex);
+
+		for (auto& page : m_PagePool)
+		{
+			m_SharedPages->Pages.push_back(std::move(page));
+		}
+
+		m_PagePool.clear();
+	}
+}
+
+size_t UploadBuffer::RetirePages(PagePool& pages)
+{
+	size_t numKept = 0;
+	for (auto& page : pages)
+	{
+		RecordUsage(*page);
 		page->Reset();
+
+		if (page->GetIdleResets() >= m_MaxIdleResets)
+		{
+			++m_Statistics.NumPagesTrimmed;
+			continue;
+		}
+
+		if (&pages[numKept] != &page)
+		{
+			pages[numKept] = std::move(page);
+		}
+
+		++numKept;
+	}
+
+	pages.resize(numKept);
+	return numKept;
+}
+
+void UploadBuffer::RecordUsage(const Page& page)
+{
+	m_Statistics.BytesUsed += page.GetUsedBytes();
+	m_Statistics.AlignmentWaste += page.GetUsedBytes() - page.GetRequestedBytes();
+}
+
+UploadBuffer::Page* UploadBuffer::ReplaceCurrentPage(Page* fullPage)
+{
+	std::lock_guard<std::mutex> lock(m_PageMutex);
+
+	// Threads that found the same page full queue up here; only the first
+	// installs a new one and the rest pick it up.
+	Page* page = m_CurrentPage.load(std::memory_order_acquire);
+	if (page == fullPage)
+	{
+		page = RequestPageLocked();
+		m_CurrentPage.store(page, std::memory_order_release);
 	}
+
+	return page;
 }
 
-std::shared_ptr<UploadBuffer::Page> UploadBuffer::RequestPage()
+UploadBuffer::Page* UploadBuffer::RequestPageLocked()
 {
+	if (m_NextAvailablePage < m_PagePool.size())
+	{
+		return m_PagePool[m_NextAvailablePage++].get();
+	}
+
 	std::shared_ptr<Page> page;
-	if (!m_AvailablePages.empty())
+	if (m_SharedPages)
 	{
-		page = m_AvailablePages.front();
-		m_AvailablePages.pop_front();
+		std::lock_guard<std::mutex> sharedLock(m_SharedPages->Mutex);
+
+		if (!m_SharedPages->Pages.empty())
+		{
+			page = std::move(m_SharedPages->Pages.front());
+			m_SharedPages->Pages.pop_front();
+		}
 	}
-	else
+
+	if (!page)
 	{
 		page = std::make_shared<Page>(m_PageSize);
-		m_PagePool.push_back(page);
 	}
 
-	return page;
+	m_NewPages.push_back(page);
+	return page.get();
+}
+
+UploadBuffer::Allocation UploadBuffer::AllocateLarge(size_t sizeInBytes, size_t alignment)
+{
+	// Buffers are placed on 64KB boundaries, so only stricter alignments need
+	// extra room in front of the allocation.
+	size_t requiredSize = Math::AlignUp(sizeInBytes, alignment);
+	if (alignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)
+	{
+		requiredSize += alignment;
+	}
+
+	uint32_t sizeClass = LargePageClass(requiredSize);
+	if (sizeClass >= NumLargePageClasses)
+	{
+		throw std::bad_alloc();
+	}
+
+	std::lock_guard<std::mutex> lock(m_PageMutex);
+
+	std::shared_ptr<Page> page;
+	auto& availablePages = m_AvailableLargePages[sizeClass];
+	if (!availablePages.empty())
+	{
+		page = availablePages.back();
+		availablePages.pop_back();
+	}
+	else
+	{
+		page = std::make_shared<Page>(size_t(1) << sizeClass);
+	}
+
+	m_LargePagesInUse.push_back(page);
+	return page->Allocate(sizeInBytes, alignment);
 }
 
 UploadBuffer::Page::Page(size_t sizeInBytes)
 	: m_PageSize(sizeInBytes)
 	, m_Offset(0)
+	, m_RequestedBytes(0)
+	, m_IdleResets(0)
 	, m_cpuPtr(nullptr)
 	, m_gpuPtr(D3D12_GPU_VIRTUAL_ADDRESS(0))
 {
@@ -76,43 +235,55 @@ UploadBuffer::Page::Page(size_t sizeInBytes)
 
 	m_gpuPtr = m_resource->GetGPUVirtualAddress();
 	m_resource->Map(0, nullptr, &m_cpuPtr);
+	WriteCombined::RegisterMappedRange(m_cpuPtr, m_PageSize);
 }
 
 UploadBuffer::Page::~Page()
 {
+	WriteCombined::UnregisterMappedRange(m_cpuPtr);
 	m_resource->Unmap(0, nullptr);
 	m_cpuPtr = nullptr;
 	m_gpuPtr = D3D12_GPU_VIRTUAL_ADDRESS(0);
 }
 
-bool UploadBuffer::Page::HasSpace(size_t sizeInBytes, size_t alignment) const
+bool UploadBuffer::Page::TryAllocate(size_t sizeInBytes, size_t alignment, Allocation& allocation)
 {
 	size_t alignedSize = Math::AlignUp(sizeInBytes, alignment);
-	size_t alignedOffset = Math::AlignUp(m_Offset, alignment);
+	size_t offset = m_Offset.load(std::memory_order_relaxed);
+	size_t alignedOffset;
+
+	do
+	{
+		alignedOffset = Math::AlignUp(offset, alignment);
+		if (alignedOffset + alignedSize > m_PageSize)
+		{
+			return false;
+		}
+	} while (!m_Offset.compare_exchange_weak(offset, alignedOffset + alignedSize, std::memory_order_relaxed));
+
+	m_RequestedBytes.fetch_add(sizeInBytes, std::memory_order_relaxed);
+
+	allocation.CPU = static_cast<uint8_t*>(m_cpuPtr) + alignedOffset;
+	allocation.GPU = m_gpuPtr + alignedOffset;
 
-	return alignedOffset + alignedSize <= m_PageSize;
+	return true;
 }
 
 UploadBuffer::Allocation UploadBuffer::Page::Allocate(size_t sizeInBytes, size_t alignment)
 {
-	if (!HasSpace(sizeInBytes, alignment))
+	Allocation alloc;
+	if (!TryAllocate(sizeInBytes, alignment, alloc))
 	{
 		throw std::bad_alloc();
 	}
 
-	size_t alignedSize = Math::AlignUp(sizeInBytes, alignment);
-	m_Offset = Math::AlignUp(m_Offset, alignment);
-
-	Allocation alloc;
-	alloc.CPU = static_cast<uint8_t*>(m_cpuPtr) + m_Offset;
-	alloc.GPU = m_gpuPtr + m_Offset;
-
-	m_Offset += alignedSize;
-
 	return alloc;
 }
 
 void UploadBuffer::Page::Reset()
 {
-	m_Offset = 0;
+	m_IdleResets = m_Offset.load(std::memory_order_relaxed) > 0 ? 0 : m_IdleResets + 1;
+
+	m_Offset.store(0, std::memory_order_relaxed);
+	m_RequestedBytes.store(0, std::memory_order_relaxed);
 }
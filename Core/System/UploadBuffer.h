@@ -1,8 +1,14 @@
 #pragma once
 #include "../Globals/stdafx.h"
 #include "../Globals/Helpers.h"
+#include "WriteCombinedMemory.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <deque>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 class UploadBuffer
 {
@@ -13,25 +19,108 @@ public:
 		D3D12_GPU_VIRTUAL_ADDRESS GPU;
 	};
 
-	explicit UploadBuffer(size_t pageSize = _2MB);
+	struct Statistics
+	{
+		size_t NumPages = 0;
+		size_t NumLargePages = 0;
+		size_t NumPagesTrimmed = 0;
+
+		// For the frame closed by the last Reset.
+		uint64_t BytesUsed = 0;
+		uint64_t AlignmentWaste = 0;
+	};
+
+	// Pages left untouched for maxIdleResets consecutive resets are released.
+	explicit UploadBuffer(size_t pageSize = _2MB, uint32_t maxIdleResets = 120);
 
 	virtual ~UploadBuffer();
 
 	size_t GetPageSize() const { return m_PageSize; }
 
+	// Safe to call from several threads at once. Small requests bump an atomic
+	// offset in the current page without locking. Replacing a full page takes
+	// the page lock, and only one of the threads that found it full installs
+	// the next page. Requests larger than the page size get a dedicated page
+	// rounded up to a power of two, which is pooled by size class and reused
+	// after Reset.
 	Allocation Allocate(size_t sizeInBytes, size_t alignment);
 
+	// Copies sizeInBytes of data into a new allocation using streaming stores.
+	Allocation Upload(const void* data, size_t sizeInBytes, size_t alignment);
+
+	// Constructs a T directly in mapped memory, placed and padded for use as a
+	// constant buffer, and returns its GPU address. T is never destroyed, so it
+	// must be trivially destructible.
+	template<typename T, typename... Args>
+	D3D12_GPU_VIRTUAL_ADDRESS Emplace(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Upload memory is recycled without running destructors.");
+
+		constexpr size_t alignedSize = (sizeof(T) + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) &
+			~size_t(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
+
+		Allocation allocation = Allocate(alignedSize, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		new (allocation.CPU) T(std::forward<Args>(args)...);
+
+		return allocation.GPU;
+	}
+
+	// Copies count values into one contiguous constant buffer placed the same
+	// way as Emplace.
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS EmplaceArray(const T* values, size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Upload memory is recycled without running destructors.");
+
+		size_t alignedSize = Math::AlignUp(sizeof(T) * count, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+		Allocation allocation = Allocate(alignedSize, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+		CopyArray(allocation.CPU, values, count, std::is_trivially_copyable<T>());
+
+		return allocation.GPU;
+	}
+
+	// Must not race with Allocate.
 	void Reset();
 
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
 private:
+	friend class UploadBufferRing;
+
+	template<typename T>
+	static void CopyArray(void* destination, const T* values, size_t count, std::true_type /*isTriviallyCopyable*/)
+	{
+		WriteCombined::Copy(destination, values, sizeof(T) * count);
+	}
+
+	template<typename T>
+	static void CopyArray(void* destination, const T* values, size_t count, std::false_type /*isTriviallyCopyable*/)
+	{
+		T* typedDestination = static_cast<T*>(destination);
+		for (size_t i = 0; i < count; ++i)
+		{
+			new (typedDestination + i) T(values[i]);
+		}
+	}
+
 	struct Page
 	{
 		Page(size_t sizeInBytes);
 		~Page();
-		bool HasSpace(size_t sizeInBytes, size_t alignment) const;
+		bool TryAllocate(size_t sizeInBytes, size_t alignment, Allocation& allocation);
 		Allocation Allocate(size_t sizeInBytes, size_t alignment);
+
+		// Rewinds the page and bumps its idle count unless it was used since
+		// the previous reset.
 		void Reset();
 
+		size_t GetPageSize() const { return m_PageSize; }
+		size_t GetUsedBytes() const { return m_Offset.load(std::memory_order_relaxed); }
+		size_t GetRequestedBytes() const { return m_RequestedBytes.load(std::memory_order_relaxed); }
+		uint32_t GetIdleResets() const { return m_IdleResets; }
+
 	private:
 		ComPtr<ID3D12Resource> m_resource;
 
@@ -39,18 +128,56 @@ private:
 		D3D12_GPU_VIRTUAL_ADDRESS m_gpuPtr;
 
 		size_t m_PageSize;
-		size_t m_Offset;
+		std::atomic<size_t> m_Offset;
+		std::atomic<size_t> m_RequestedBytes;
+		uint32_t m_IdleResets;
 	};
 
 	using PagePool = std::deque<std::shared_ptr<Page>>;
 
-	std::shared_ptr<Page> RequestPage();
+	// Pages handed between the slices of an UploadBufferRing. Each slice has
+	// its own page mutex, so the pool carries a lock of its own.
+	struct SharedPagePool
+	{
+		std::mutex Mutex;
+		PagePool Pages;
+	};
+
+	// Used by UploadBufferRing so every slice draws from, and resets into, one
+	// pool of pages instead of each holding on to its own.
+	UploadBuffer(size_t pageSize, uint32_t maxIdleResets, std::shared_ptr<SharedPagePool> sharedPages);
+
+	// Returns the current page, installing a new one first if it is still
+	// fullPage.
+	Page* ReplaceCurrentPage(Page* fullPage);
+	Page* RequestPageLocked();
+	Allocation AllocateLarge(size_t sizeInBytes, size_t alignment);
+
+	// Resets every page of the pool, drops those idle for too long and keeps
+	// the rest in place. Returns the number kept.
+	size_t RetirePages(PagePool& pages);
+	void RecordUsage(const Page& page);
 
+	static constexpr uint32_t NumLargePageClasses = 64;
+
+	// Pages kept from earlier frames, handed out in order as pages fill up.
 	PagePool m_PagePool;
-	PagePool m_AvailablePages;
+	size_t m_NextAvailablePage;
+
+	// Pages created or taken from the shared pool during the current frame.
+	PagePool m_NewPages;
 
-	std::shared_ptr<Page> m_CurrentPage;
+	std::atomic<Page*> m_CurrentPage;
+	std::shared_ptr<SharedPagePool> m_SharedPages;
+
+	PagePool m_LargePagesInUse;
+	PagePool m_AvailableLargePages[NumLargePageClasses];
 
 	size_t m_PageSize;
+	uint32_t m_MaxIdleResets;
+	Statistics m_Statistics;
+
+	// Guards page hand-out, m_NewPages and the large page pools.
+	std::mutex m_PageMutex;
 };
 
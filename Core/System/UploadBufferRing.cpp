@@ -0,0 +1,88 @@
+#include "UploadBufferRing.h"
+#include "CommandQueue.h"
+
+UploadBufferRing::UploadBufferRing(size_t pageSize, uint32_t numFramesInFlight, uint32_t maxIdleResets)
+	: m_SharedPages(std::make_shared<UploadBuffer::SharedPagePool>())
+	, m_Slices(numFramesInFlight)
+	, m_CurrentSlice(0)
+	, m_MaxIdleResets(maxIdleResets)
+{
+	for (auto& slice : m_Slices)
+	{
+		slice.Buffer.reset(new UploadBuffer(pageSize, maxIdleResets, m_SharedPages));
+	}
+}
+
+UploadBufferRing::~UploadBufferRing()
+{
+}
+
+UploadBuffer::Allocation UploadBufferRing::Allocate(size_t sizeInBytes, size_t alignment)
+{
+	return GetCurrentSlice().Allocate(sizeInBytes, alignment);
+}
+
+void UploadBufferRing::Reset(std::shared_ptr<CommandQueue> commandQueue, uint64_t fenceValue)
+{
+	auto& current = m_Slices[m_CurrentSlice];
+	current.Queue = std::move(commandQueue);
+	current.FenceValue = fenceValue;
+
+	// Age the pages nobody picked up this frame before recycled slices add theirs.
+	TrimSharedPages();
+
+	for (auto& slice : m_Slices)
+	{
+		if (slice.Queue && slice.Queue->IsFenceComplete(slice.FenceValue))
+		{
+			RecycleSlice(slice);
+		}
+	}
+
+	m_CurrentSlice = (m_CurrentSlice + 1) % static_cast<uint32_t>(m_Slices.size());
+
+	auto& next = m_Slices[m_CurrentSlice];
+	if (next.Queue)
+	{
+		next.Queue->WaitForFenceValue(next.FenceValue);
+		RecycleSlice(next);
+	}
+}
+
+size_t UploadBufferRing::GetNumSharedPages() const
+{
+	std::lock_guard<std::mutex> lock(m_SharedPages->Mutex);
+	return m_SharedPages->Pages.size();
+}
+
+void UploadBufferRing::RecycleSlice(Slice& slice)
+{
+	slice.Buffer->Reset();
+	slice.Queue.reset();
+	slice.FenceValue = 0;
+}
+
+void UploadBufferRing::TrimSharedPages()
+{
+	std::lock_guard<std::mutex> lock(m_SharedPages->Mutex);
+	auto& pages = m_SharedPages->Pages;
+
+	size_t numKept = 0;
+	for (auto& page : pages)
+	{
+		page->Reset();
+		if (page->GetIdleResets() >= m_MaxIdleResets)
+		{
+			continue;
+		}
+
+		if (&pages[numKept] != &page)
+		{
+			pages[numKept] = std::move(page);
+		}
+
+		++numKept;
+	}
+
+	pages.resize(numKept);
+}
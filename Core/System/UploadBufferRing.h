@@ -0,0 +1,45 @@
+#pragma once
+#include "UploadBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CommandQueue;
+
+// Owns one UploadBuffer slice per frame in flight. A slice is reset only once
+// the fence of the frame that filled it has completed, and its pages go back to
+// a pool shared by every slice so a heavy frame doesn't pin memory to one slot.
+class UploadBufferRing
+{
+public:
+	explicit UploadBufferRing(size_t pageSize = _2MB, uint32_t numFramesInFlight = 3, uint32_t maxIdleResets = 120);
+	virtual ~UploadBufferRing();
+
+	UploadBuffer::Allocation Allocate(size_t sizeInBytes, size_t alignment);
+
+	UploadBuffer& GetCurrentSlice() { return *m_Slices[m_CurrentSlice].Buffer; }
+
+	// Closes the current frame, whose work completes at fenceValue on
+	// commandQueue, and recycles every slice whose fence has since completed.
+	// Waits on the CPU only if the next slice's frame is still in flight.
+	void Reset(std::shared_ptr<CommandQueue> commandQueue, uint64_t fenceValue);
+
+	size_t GetNumSharedPages() const;
+
+private:
+	struct Slice
+	{
+		std::unique_ptr<UploadBuffer> Buffer;
+		std::shared_ptr<CommandQueue> Queue;
+		uint64_t FenceValue = 0;
+	};
+
+	void RecycleSlice(Slice& slice);
+	void TrimSharedPages();
+
+	std::shared_ptr<UploadBuffer::SharedPagePool> m_SharedPages;
+	std::vector<Slice> m_Slices;
+	uint32_t m_CurrentSlice;
+	uint32_t m_MaxIdleResets;
+};
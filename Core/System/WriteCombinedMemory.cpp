@@ -0,0 +1,216 @@
+#include "WriteCombinedMemory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <intrin.h>
+#include <map>
+#include <mutex>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define WRITE_COMBINED_SIMD 1
+#endif
+
+namespace
+{
+	// Below this the setup costs more than the stores save.
+	constexpr size_t StreamingThreshold = 64;
+
+#if defined(WRITE_COMBINED_SIMD)
+	bool DetectAVX2()
+	{
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+
+	const bool s_HasAVX2 = DetectAVX2();
+
+	void CopySSE2(uint8_t* destination, const uint8_t* source, size_t sizeInBytes)
+	{
+		size_t head = (16 - (reinterpret_cast<uintptr_t>(destination) & 15)) & 15;
+		head = std::min(head, sizeInBytes);
+		std::memcpy(destination, source, head);
+		destination += head;
+		source += head;
+		sizeInBytes -= head;
+
+		for (; sizeInBytes >= 64; sizeInBytes -= 64, destination += 64, source += 64)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 16));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 32));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 48));
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination), a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination + 16), b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination + 32), c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination + 48), d);
+		}
+
+		for (; sizeInBytes >= 16; sizeInBytes -= 16, destination += 16, source += 16)
+		{
+			_mm_stream_si128(reinterpret_cast<__m128i*>(destination), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+		}
+
+		std::memcpy(destination, source, sizeInBytes);
+	}
+
+	void CopyAVX2(uint8_t* destination, const uint8_t* source, size_t sizeInBytes)
+	{
+		size_t head = (32 - (reinterpret_cast<uintptr_t>(destination) & 31)) & 31;
+		head = std::min(head, sizeInBytes);
+		std::memcpy(destination, source, head);
+		destination += head;
+		source += head;
+		sizeInBytes -= head;
+
+		for (; sizeInBytes >= 128; sizeInBytes -= 128, destination += 128, source += 128)
+		{
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 32));
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 64));
+			__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 96));
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination), a);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + 32), b);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + 64), c);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + 96), d);
+		}
+
+		for (; sizeInBytes >= 32; sizeInBytes -= 32, destination += 32, source += 32)
+		{
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(destination), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source)));
+		}
+
+		std::memcpy(destination, source, sizeInBytes);
+	}
+#endif
+
+#if defined(_DEBUG)
+	std::mutex s_MappedRangeMutex;
+	std::map<uintptr_t, size_t> s_MappedRanges;
+
+	// [begin, end) of the lowest and highest mapped ranges, updated under the
+	// mutex and read without it.
+	std::atomic<uintptr_t> s_MappedSpanBegin{ UINTPTR_MAX };
+	std::atomic<uintptr_t> s_MappedSpanEnd{ 0 };
+
+	void UpdateMappedSpanLocked()
+	{
+		bool empty = s_MappedRanges.empty();
+		s_MappedSpanBegin.store(empty ? UINTPTR_MAX : s_MappedRanges.begin()->first, std::memory_order_relaxed);
+		s_MappedSpanEnd.store(empty ? 0 : s_MappedRanges.rbegin()->first + s_MappedRanges.rbegin()->second, std::memory_order_relaxed);
+	}
+#endif
+}
+
+void WriteCombined::Copy(void* destination, const void* source, size_t sizeInBytes)
+{
+#if defined(WRITE_COMBINED_SIMD)
+	if (sizeInBytes >= StreamingThreshold)
+	{
+		CopyWithKernel(s_HasAVX2 ? Kernel::AVX2 : Kernel::SSE2, destination, source, sizeInBytes);
+		return;
+	}
+#endif
+
+	CopyWithKernel(Kernel::Memcpy, destination, source, sizeInBytes);
+}
+
+bool WriteCombined::IsKernelSupported(Kernel kernel)
+{
+	switch (kernel)
+	{
+#if defined(WRITE_COMBINED_SIMD)
+	case Kernel::SSE2:
+		return true;
+	case Kernel::AVX2:
+		return s_HasAVX2;
+#endif
+	case Kernel::Memcpy:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void WriteCombined::CopyWithKernel(Kernel kernel, void* destination, const void* source, size_t sizeInBytes)
+{
+	AssertNotMapped(source, sizeInBytes);
+	assert(IsKernelSupported(kernel));
+
+#if defined(WRITE_COMBINED_SIMD)
+	if (kernel != Kernel::Memcpy)
+	{
+		if (kernel == Kernel::AVX2)
+		{
+			CopyAVX2(static_cast<uint8_t*>(destination), static_cast<const uint8_t*>(source), sizeInBytes);
+		}
+		else
+		{
+			CopySSE2(static_cast<uint8_t*>(destination), static_cast<const uint8_t*>(source), sizeInBytes);
+		}
+
+		// Streaming stores are weakly ordered; make them visible before the
+		// caller goes on to submit work that reads them.
+		_mm_sfence();
+		return;
+	}
+#endif
+
+	std::memcpy(destination, source, sizeInBytes);
+}
+
+void WriteCombined::RegisterMappedRange(const void* base, size_t sizeInBytes)
+{
+#if defined(_DEBUG)
+	std::lock_guard<std::mutex> lock(s_MappedRangeMutex);
+	s_MappedRanges[reinterpret_cast<uintptr_t>(base)] = sizeInBytes;
+	UpdateMappedSpanLocked();
+#endif
+}
+
+void WriteCombined::UnregisterMappedRange(const void* base)
+{
+#if defined(_DEBUG)
+	std::lock_guard<std::mutex> lock(s_MappedRangeMutex);
+	s_MappedRanges.erase(reinterpret_cast<uintptr_t>(base));
+	UpdateMappedSpanLocked();
+#endif
+}
+
+void WriteCombined::AssertNotMapped(const void* address, size_t sizeInBytes)
+{
+#if defined(_DEBUG)
+	uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+	uintptr_t end = begin + sizeInBytes;
+
+	if (end <= s_MappedSpanBegin.load(std::memory_order_relaxed) || begin >= s_MappedSpanEnd.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_MappedRangeMutex);
+
+	// The only candidate is the last range starting before the end of the read.
+	auto iter = s_MappedRanges.lower_bound(end);
+	if (iter != s_MappedRanges.begin())
+	{
+		--iter;
+		assert(iter->first + iter->second <= begin && "Reading from write-combined upload memory.");
+	}
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "../Globals/stdafx.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Helpers for filling CPU-mapped upload heap memory, which is write-combined:
+// writes are cheap when they are sequential and full-line, reads are uncached.
+namespace WriteCombined
+{
+	// Copies with non-temporal stores (AVX2 or SSE2, picked at startup) so the
+	// source never pollutes the cache and destination lines are never read.
+	// Falls back to memcpy for small copies and non-x86 targets.
+	void Copy(void* destination, const void* source, size_t sizeInBytes);
+
+	// The kernels Copy picks between, exposed for tests and benchmarks.
+	// CopyWithKernel runs the kernel at any size; unsupported ones must not be
+	// passed.
+	enum class Kernel
+	{
+		Memcpy,
+		SSE2,
+		AVX2
+	};
+
+	bool IsKernelSupported(Kernel kernel);
+	void CopyWithKernel(Kernel kernel, void* destination, const void* source, size_t sizeInBytes);
+
+	// Debug builds track mapped upload ranges and assert when Copy is asked to
+	// read from one. Reads outside the span of all mapped ranges skip the lock.
+	// Release builds compile these to nothing.
+	void RegisterMappedRange(const void* base, size_t sizeInBytes);
+	void UnregisterMappedRange(const void* base);
+	void AssertNotMapped(const void* address, size_t sizeInBytes);
+}
@@ -0,0 +1,90 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Timer.h"
+#include "../Core/System/Descriptors/BindlessDescriptorHeap.h"
+
+#include <cstdio>
+#include <vector>
+
+static uint32_t RegisterNullView(BindlessDescriptorHeap& heap)
+{
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+	return heap.RegisterConstantBufferView(&cbvDesc);
+}
+
+DEVICE_TEST(BindlessIndicesAreRecycledAfterTheFence)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	auto heap = std::make_shared<BindlessDescriptorHeap>(16);
+
+	uint32_t index = RegisterNullView(*heap);
+	CHECK(heap->GetNumFreeIndices() == 15);
+
+	QueueGate gate(*queue);
+	uint64_t fenceValue = queue->Signal();
+
+	heap->Release(index);
+	queue->ProcessCompletedFences();
+	CHECK(heap->GetNumPendingReleases() == 1);
+	CHECK(heap->GetNumFreeIndices() == 15);
+
+	gate.Release();
+	queue->WaitForFenceValue(fenceValue);
+
+	CHECK(heap->GetNumPendingReleases() == 0);
+	CHECK(heap->GetNumFreeIndices() == 16);
+}
+
+BENCHMARK(BindlessIndexChurn)
+{
+	const uint32_t NumLiveIndices = 32768;
+	const uint32_t NumChurnedPerFrame = 2048;
+	const uint32_t NumFrames = 200;
+
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+	for (bool batched : { false, true })
+	{
+		auto heap = std::make_shared<BindlessDescriptorHeap>(NumLiveIndices * 2);
+
+		std::vector<uint32_t> live;
+		for (uint32_t i = 0; i < NumLiveIndices; ++i)
+		{
+			live.push_back(RegisterNullView(*heap));
+		}
+
+		Timer timer;
+		for (uint32_t frame = 0; frame < NumFrames; ++frame)
+		{
+			// Replace a sliding window of materials each frame.
+			uint32_t first = (frame * NumChurnedPerFrame) % NumLiveIndices;
+
+			if (batched)
+			{
+				heap->Release(&live[first], NumChurnedPerFrame);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < NumChurnedPerFrame; ++i)
+				{
+					heap->Release(live[first + i]);
+				}
+			}
+
+			for (uint32_t i = 0; i < NumChurnedPerFrame; ++i)
+			{
+				live[first + i] = RegisterNullView(*heap);
+			}
+
+			queue->Signal();
+		}
+		timer.Tick();
+
+		queue->Flush();
+
+		double numOperations = 2.0 * NumChurnedPerFrame * NumFrames;
+		printf("BindlessIndexChurn %s: %8.2f M register+release/s, %u free after flush\n",
+			batched ? "batched releases" : "single releases ", numOperations / timer.GetDeltaSeconds() * 1e-6, heap->GetNumFreeIndices());
+	}
+}
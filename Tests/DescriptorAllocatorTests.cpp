@@ -0,0 +1,170 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Descriptors/DescriptorAllocator.h"
+#include "../Core/System/Timer.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+DEVICE_TEST(StaleDescriptorsAreReusedOnceTheFenceCompletes)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4);
+
+	DescriptorAllocation allocation = allocator.Allocate(4);
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = allocation.GetDescriptorHandle();
+	CHECK(allocator.GetStatistics().NumFreeHandles == 0);
+
+	QueueGate gate(*queue);
+	uint64_t fenceValue = queue->Signal();
+
+	// Freed while the queue may still read the descriptors.
+	allocation = DescriptorAllocation();
+	queue->ProcessCompletedFences();
+	CHECK(!queue->IsFenceComplete(fenceValue));
+	CHECK(allocator.GetStatistics().NumFreeHandles == 0);
+
+	gate.Release();
+	queue->WaitForFenceValue(fenceValue);
+
+	auto stats = allocator.GetStatistics();
+	CHECK(stats.NumPages == 1);
+	CHECK(stats.NumFreeHandles == 4);
+
+	allocation = allocator.Allocate(4);
+	CHECK(allocation.GetDescriptorHandle().ptr == handle.ptr);
+}
+
+DEVICE_TEST(DescriptorAllocatorReusesRetiredSpaceBeforeGrowing)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 8);
+
+	std::vector<DescriptorAllocation> allocations;
+	for (int i = 0; i < 16; ++i)
+	{
+		allocations.push_back(allocator.Allocate(4));
+	}
+	CHECK(allocator.GetStatistics().NumPages == 8);
+
+	// Free one range in every other page; each page queues itself once.
+	for (size_t i = 0; i < allocations.size(); i += 4)
+	{
+		allocations[i] = DescriptorAllocation();
+	}
+	queue->WaitForFenceValue(queue->Signal());
+
+	for (int i = 0; i < 4; ++i)
+	{
+		CHECK(!allocator.Allocate(4).IsNull());
+	}
+	CHECK(allocator.GetStatistics().NumPages == 8);
+}
+
+DEVICE_TEST(DescriptorAllocatorBatchFillsExistingPagesBeforeGrowing)
+{
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 8);
+
+	// Two pages with two free descriptors each.
+	DescriptorAllocation first = allocator.Allocate(6);
+	DescriptorAllocation second = allocator.Allocate(6);
+	CHECK(allocator.GetStatistics().NumPages == 2);
+
+	// No page holds all four, but each range fits somewhere.
+	const uint32_t Counts[] = { 2, 0, 2 };
+	auto allocations = allocator.AllocateBatch(Counts, 3);
+	CHECK(allocations[0].GetNumHandles() == 2);
+	CHECK(allocations[1].IsNull());
+	CHECK(allocations[2].GetNumHandles() == 2);
+
+	auto stats = allocator.GetStatistics();
+	CHECK(stats.NumPages == 2);
+	CHECK(stats.NumFreeHandles == 0);
+
+	// With no room left the batch goes to one new page as one block.
+	allocations = allocator.AllocateBatch(Counts, 3);
+	CHECK(allocator.GetStatistics().NumPages == 3);
+	SIZE_T increment = allocations[0].GetDescriptorHandle(1).ptr - allocations[0].GetDescriptorHandle().ptr;
+	CHECK(allocations[2].GetDescriptorHandle().ptr == allocations[0].GetDescriptorHandle().ptr + 2 * increment);
+}
+
+BENCHMARK(DescriptorAllocatorManyPages)
+{
+	const uint32_t NumPages = 4096;
+	const uint32_t DescriptorsPerPage = 64;
+	const uint32_t NumRequests = 10000;
+
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, DescriptorsPerPage);
+
+	std::mt19937 random(1234);
+	std::vector<DescriptorAllocation> allocations;
+	allocations.reserve(NumPages * DescriptorsPerPage / 2);
+
+	while (allocator.GetStatistics().NumPages < NumPages)
+	{
+		allocations.push_back(allocator.Allocate(2 + random() % 15));
+	}
+
+	// Punch holes across the pool so requests land in partially used pages.
+	for (size_t i = 0; i < allocations.size(); i += 3)
+	{
+		allocations[i] = DescriptorAllocation();
+	}
+	queue->WaitForFenceValue(queue->Signal());
+
+	std::vector<DescriptorAllocation> requests;
+	requests.reserve(NumRequests);
+
+	Timer timer;
+	for (uint32_t i = 0; i < NumRequests; ++i)
+	{
+		uint32_t size = random() % 8 == 0 ? 16 + random() % 48 : 2 + random() % 7;
+		requests.push_back(allocator.Allocate(size));
+	}
+	timer.Tick();
+
+	auto stats = allocator.GetStatistics();
+	printf("DescriptorAllocator %zu pages, %u mixed requests: %8.3f ms, %zu pages after\n",
+		static_cast<size_t>(NumPages), NumRequests, timer.GetDeltaSeconds() * 1000.0, stats.NumPages);
+}
+
+BENCHMARK(DescriptorAllocatorBatchedMaterials)
+{
+	const uint32_t NumMaterials = 10000;
+	const uint32_t Counts[] = { 4, 2, 1, 3 };
+	const uint32_t NumRanges = 4;
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1024);
+
+		std::vector<DescriptorAllocation> allocations;
+		allocations.reserve(NumMaterials * NumRanges);
+
+		Timer timer;
+		for (uint32_t material = 0; material < NumMaterials; ++material)
+		{
+			if (pass == 0)
+			{
+				for (uint32_t range = 0; range < NumRanges; ++range)
+				{
+					allocations.push_back(allocator.Allocate(Counts[range]));
+				}
+			}
+			else
+			{
+				for (auto& allocation : allocator.AllocateBatch(Counts, NumRanges))
+				{
+					allocations.push_back(std::move(allocation));
+				}
+			}
+		}
+		timer.Tick();
+
+		printf("%-8s %u materials: %8.3f ms, %zu pages\n", pass == 0 ? "Single" : "Batched",
+			NumMaterials, timer.GetDeltaSeconds() * 1000.0, allocator.GetStatistics().NumPages);
+	}
+}
@@ -0,0 +1,50 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Descriptors/DescriptorAllocator.h"
+#include "../Core/System/Descriptors/DescriptorIndirectionTable.h"
+#include "../Core/System/Descriptors/ThreadDescriptorCache.h"
+
+#include <future>
+#include <thread>
+
+DEVICE_TEST(CompactionSkipsPagesCachedByOtherThreads)
+{
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 256);
+	DescriptorIndirectionTable table(allocator);
+
+	std::promise<void> rangeCached;
+	std::promise<void> flushRequested;
+
+	// The worker takes a cached range from the first page and holds on to it.
+	std::thread worker([&]
+	{
+		{
+			DescriptorAllocation allocation = allocator.Allocate();
+		}
+
+		rangeCached.set_value();
+		flushRequested.get_future().wait();
+		ThreadDescriptorCache::Flush();
+	});
+
+	rangeCached.get_future().wait();
+
+	// Leave the first page sparsely used and give the second plenty of room.
+	table.Allocate(2);
+
+	DescriptorAllocation filler = allocator.Allocate(200);
+	DescriptorAllocation secondPage = allocator.Allocate(100);
+
+	filler = DescriptorAllocation();
+	Application::Get().Flush();
+
+	uint32_t numMovedWhileCached = table.Compact(0.25f);
+
+	flushRequested.set_value();
+	worker.join();
+
+	CHECK(numMovedWhileCached == 0);
+	CHECK(allocator.GetStatistics().NumPages == 2);
+	CHECK(table.Compact(0.25f) == 1);
+}
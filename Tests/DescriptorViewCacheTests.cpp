@@ -0,0 +1,86 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Descriptors/DescriptorAllocator.h"
+#include "../Core/System/Descriptors/DescriptorViewCache.h"
+
+DEVICE_TEST(DescriptorViewCacheEvictsLeastRecentlyUsedUnreferencedView)
+{
+	auto device = Application::Get().GetDevice();
+
+	ComPtr<ID3D12Resource> buffer;
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(64 * 1024);
+	ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer)));
+
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	DescriptorViewCache cache(allocator, 4);
+
+	auto getView = [&](uint32_t i)
+	{
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+		cbvDesc.BufferLocation = buffer->GetGPUVirtualAddress() + i * D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+		cbvDesc.SizeInBytes = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+		return cache.GetConstantBufferView(buffer.Get(), &cbvDesc);
+	};
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		getView(i);
+	}
+
+	// Least to most recent: 1 (still referenced), 2, 3, 0.
+	auto referenced = getView(1);
+	getView(2);
+	getView(3);
+	getView(0);
+
+	getView(4);
+
+	auto stats = cache.GetStatistics();
+	CHECK(stats.Evictions == 1);
+	CHECK(stats.NumCachedViews == 4);
+
+	uint64_t misses = stats.Misses;
+	getView(1);
+	getView(3);
+	getView(0);
+	CHECK(cache.GetStatistics().Misses == misses);
+
+	getView(2);
+	CHECK(cache.GetStatistics().Misses == misses + 1);
+}
+
+DEVICE_TEST(DescriptorViewCacheDoesNotKeepResourcesAlive)
+{
+	auto device = Application::Get().GetDevice();
+
+	ComPtr<ID3D12Resource> buffer;
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(64 * 1024);
+	ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer)));
+
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	DescriptorViewCache cache(allocator);
+
+	auto countReferences = [&]()
+	{
+		buffer->AddRef();
+		return buffer->Release();
+	};
+
+	ULONG references = countReferences();
+
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+	cbvDesc.BufferLocation = buffer->GetGPUVirtualAddress();
+	cbvDesc.SizeInBytes = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+	cache.GetConstantBufferView(buffer.Get(), &cbvDesc);
+
+	CHECK(countReferences() == references);
+	CHECK(cache.GetStatistics().NumCachedViews == 1);
+
+	cache.EvictResource(buffer.Get());
+	CHECK(cache.GetStatistics().NumCachedViews == 0);
+}
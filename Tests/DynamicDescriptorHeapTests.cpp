@@ -0,0 +1,95 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Descriptors/DescriptorAllocator.h"
+#include "../Core/System/Descriptors/DynamicDescriptorHeap.h"
+
+namespace
+{
+	// Two SRV tables: four descriptors at root index 0, two at root index 1.
+	struct TwoTableRootSignature
+	{
+		TwoTableRootSignature()
+		{
+			const UINT NumDescriptors[] = { 4, 2 };
+			for (UINT i = 0; i < 2; ++i)
+			{
+				Ranges[i] = {};
+				Ranges[i].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+				Ranges[i].NumDescriptors = NumDescriptors[i];
+				Ranges[i].BaseShaderRegister = i * 4;
+				Ranges[i].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+				Parameters[i] = {};
+				Parameters[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+				Parameters[i].DescriptorTable.NumDescriptorRanges = 1;
+				Parameters[i].DescriptorTable.pDescriptorRanges = &Ranges[i];
+			}
+
+			Desc = {};
+			Desc.NumParameters = 2;
+			Desc.pParameters = Parameters;
+		}
+
+		D3D12_DESCRIPTOR_RANGE1 Ranges[2];
+		D3D12_ROOT_PARAMETER1 Parameters[2];
+		D3D12_ROOT_SIGNATURE_DESC1 Desc;
+	};
+}
+
+DEVICE_TEST(DynamicDescriptorHeapCopiesOncePerDrawAndRebindsOnNewLists)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	DescriptorAllocation sources = allocator.Allocate(6);
+
+	TwoTableRootSignature rootSignature;
+	DynamicDescriptorHeap dynamicHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 64);
+	dynamicHeap.ParseRootSignature(rootSignature.Desc);
+
+	const auto& stats = dynamicHeap.GetStatistics();
+	auto firstList = queue->GetCommandList();
+	auto secondList = queue->GetCommandList();
+
+	// First draw: both tables in one copy.
+	dynamicHeap.StageDescriptors(0, 0, 4, sources.GetDescriptorHandle(0));
+	dynamicHeap.StageDescriptors(1, 0, 2, sources.GetDescriptorHandle(4));
+	dynamicHeap.CommitStagedDescriptorsForDraw(firstList.Get());
+	CHECK(stats.CopyDescriptorsCalls == 1);
+	CHECK(stats.DescriptorsCopied == 6);
+	CHECK(stats.TablesCommitted == 2);
+	CHECK(stats.HeapsBound == 1);
+
+	// Nothing changed: no copy, no rebinding.
+	dynamicHeap.CommitStagedDescriptorsForDraw(firstList.Get());
+	CHECK(stats.CopyDescriptorsCalls == 1);
+	CHECK(stats.TablesCommitted == 2);
+
+	// Only the restaged table is copied.
+	dynamicHeap.StageDescriptors(1, 0, 2, sources.GetDescriptorHandle(2));
+	dynamicHeap.CommitStagedDescriptorsForDraw(firstList.Get());
+	CHECK(stats.CopyDescriptorsCalls == 2);
+	CHECK(stats.DescriptorsCopied == 8);
+	CHECK(stats.TablesCommitted == 3);
+	CHECK(stats.HeapsBound == 1);
+
+	// A new list has nothing bound, so the heap and both tables are set again
+	// even though nothing was restaged.
+	dynamicHeap.CommitStagedDescriptorsForDraw(secondList.Get());
+	CHECK(stats.CopyDescriptorsCalls == 3);
+	CHECK(stats.DescriptorsCopied == 14);
+	CHECK(stats.TablesCommitted == 5);
+	CHECK(stats.HeapsBound == 2);
+
+	// Unstaged slots ahead of a staged one are not copied.
+	dynamicHeap.ParseRootSignature(rootSignature.Desc);
+	dynamicHeap.StageDescriptors(0, 2, 2, sources.GetDescriptorHandle(0));
+	dynamicHeap.CommitStagedDescriptorsForDraw(secondList.Get());
+	CHECK(stats.CopyDescriptorsCalls == 4);
+	CHECK(stats.DescriptorsCopied == 16);
+
+	const ComPtr<ID3D12GraphicsCommandList2> commandLists[] = { firstList, secondList };
+	uint64_t fenceValue = queue->ExecuteCommandLists(commandLists, 2);
+	dynamicHeap.Reset(queue, fenceValue);
+	queue->WaitForFenceValue(fenceValue);
+}
@@ -0,0 +1,169 @@
+#include "TestFramework.h"
+
+#include "../Core/Globals/Helpers.h"
+#include "../Core/System/Memory/HeapSubAllocator.h"
+#include "../Core/System/Timer.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+TEST(HeapSubAllocatorReturnsAlignmentPaddingToTheBlock)
+{
+	HeapSubAllocator allocator(_1MB, _64KB);
+	uint32_t block = allocator.AddBlock(0, 0);
+
+	// Aligned already: the padding after the allocation goes straight back.
+	auto first = allocator.Allocate(_64KB, 4 * _64KB, 0);
+	CHECK(first.Offset == 0);
+	CHECK(allocator.GetBlockInfo(block).UsedBytes == _64KB);
+	CHECK(allocator.GetBlockInfo(block).LargestFreeRange == _1MB - _64KB);
+
+	auto second = allocator.Allocate(_64KB, _64KB, 0);
+	CHECK(second.Offset == _64KB);
+
+	// Misaligned: the head in front of the aligned offset goes back too, and
+	// the next request fits exactly into it.
+	auto third = allocator.Allocate(_64KB, 4 * _64KB, 0);
+	CHECK(third.Offset == 4 * _64KB);
+
+	auto head = allocator.Allocate(2 * _64KB, _64KB, 0);
+	CHECK(head.Offset == 2 * _64KB);
+
+	auto info = allocator.GetBlockInfo(block);
+	CHECK(info.NumAllocations == 4);
+	CHECK(info.UsedBytes == 5 * _64KB);
+
+	allocator.Free(first);
+	allocator.Free(second);
+	allocator.Free(third);
+	allocator.Free(head);
+	CHECK(allocator.IsBlockEmpty(block));
+	CHECK(allocator.GetBlockInfo(block).LargestFreeRange == _1MB);
+}
+
+TEST(HeapSubAllocatorKeepsTagsApartAndRespectsTheBudget)
+{
+	HeapSubAllocator allocator(_1MB, _64KB, 2 * _1MB);
+
+	uint32_t buffers = allocator.AddBlock(0, 0);
+	uint32_t textures = allocator.AddBlock(0, 1);
+	CHECK(buffers != HeapSubAllocator::InvalidBlock && textures != HeapSubAllocator::InvalidBlock);
+
+	// A third block, or a larger one in place of a released one, would pass
+	// the budget.
+	CHECK(allocator.AddBlock(0, 0) == HeapSubAllocator::InvalidBlock);
+	allocator.ReleaseBlock(textures);
+	CHECK(allocator.AddBlock(2 * _1MB, 1) == HeapSubAllocator::InvalidBlock);
+
+	textures = allocator.AddBlock(0, 1);
+	CHECK(allocator.Allocate(_64KB, _64KB, 1).BlockIndex == textures);
+	CHECK(allocator.Allocate(_64KB, _64KB, 0).BlockIndex == buffers);
+	CHECK(!allocator.Allocate(_64KB, _64KB, 2).IsValid());
+
+	// Raising the budget lets the allocator grow again.
+	allocator.SetBudget(3 * _1MB);
+	CHECK(allocator.AddBlock(0, 0) != HeapSubAllocator::InvalidBlock);
+	CHECK(allocator.GetStatistics().BlockBytes == 3 * _1MB);
+}
+
+TEST(HeapSubAllocatorReleaseEmptyBlocksKeepsMinBlocksPerTag)
+{
+	HeapSubAllocator allocator(_1MB, _64KB);
+
+	std::vector<uint32_t> blocks;
+	const uint32_t Tags[] = { 0, 1, 0, 1, 0, 0 };
+	for (uint32_t tag : Tags)
+	{
+		blocks.push_back(allocator.AddBlock(0, tag));
+	}
+
+	// One tag 0 block stays occupied.
+	auto allocation = allocator.AllocateFromBlock(blocks[2], _64KB, _64KB);
+
+	// Tag 0 has three empty blocks and keeps the last; tag 1 has two and
+	// keeps the last.
+	auto released = allocator.ReleaseEmptyBlocks(1);
+	CHECK(released.size() == 3);
+	CHECK(released[0] == blocks[0] && released[1] == blocks[1] && released[2] == blocks[4]);
+
+	CHECK(allocator.GetStatistics().NumBlocks == 3);
+	CHECK(allocator.ReleaseEmptyBlocks(1).empty());
+
+	allocator.Free(allocation);
+	CHECK(allocator.ReleaseEmptyBlocks(0).size() == 3);
+	CHECK(allocator.GetStatistics().NumBlocks == 0);
+}
+
+TEST(HeapSubAllocatorOrdersDefragmentationCandidatesByOccupancy)
+{
+	HeapSubAllocator allocator(_1MB, _64KB);
+
+	// Used sixteenths of each block: one above the threshold, one empty.
+	const uint32_t UsedUnits[] = { 3, 1, 8, 2, 0 };
+	for (uint32_t units : UsedUnits)
+	{
+		uint32_t block = allocator.AddBlock(0, 0);
+		for (uint32_t i = 0; i < units; ++i)
+		{
+			allocator.AllocateFromBlock(block, _64KB, _64KB);
+		}
+	}
+
+	auto candidates = allocator.GetDefragmentationCandidates(0.25f);
+	CHECK(candidates.size() == 3);
+	CHECK(candidates[0].BlockIndex == 1);
+	CHECK(candidates[1].BlockIndex == 3);
+	CHECK(candidates[2].BlockIndex == 0);
+	CHECK(candidates[0].UsedBytes == _64KB);
+}
+
+BENCHMARK(HeapSubAllocatorMixedWorkload)
+{
+	const uint32_t NumTags = 4;
+	const uint32_t NumBlocks = 1024;
+	const uint32_t NumOperations = 200000;
+
+	HeapSubAllocator allocator(_MB(4), _64KB);
+	for (uint32_t i = 0; i < NumBlocks; ++i)
+	{
+		allocator.AddBlock(0, i % NumTags);
+	}
+
+	std::mt19937 random(1234);
+	std::vector<HeapSubAllocator::Allocation> live;
+	live.reserve(NumOperations);
+
+	uint64_t numFailed = 0;
+
+	Timer timer;
+	for (uint32_t i = 0; i < NumOperations; ++i)
+	{
+		if (live.empty() || random() % 100 < 60)
+		{
+			uint64_t size = random() % 8 == 0 ? _1MB : _64KB * (1 + random() % 4);
+			uint64_t alignment = random() % 16 == 0 ? _MB(4) : _64KB;
+
+			auto allocation = allocator.Allocate(size, alignment, random() % NumTags);
+			if (allocation.IsValid())
+			{
+				live.push_back(allocation);
+			}
+			else
+			{
+				++numFailed;
+			}
+		}
+		else
+		{
+			size_t index = random() % live.size();
+			allocator.Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+		}
+	}
+	timer.Tick();
+
+	printf("HeapSubAllocator %u blocks, %u operations: %8.3f ms, %llu failed\n",
+		NumBlocks, NumOperations, timer.GetDeltaSeconds() * 1000.0, static_cast<unsigned long long>(numFailed));
+}
@@ -0,0 +1,133 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/MPSCQueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+TEST(MPSCQueueKeepsEachProducersOrder)
+{
+	const uint32_t NumProducers = 8;
+	const uint32_t NumPushesPerProducer = 20000;
+
+	struct Item
+	{
+		uint32_t Producer;
+		uint32_t Sequence;
+	};
+
+	MPSCQueue<Item> queue;
+	std::atomic<uint32_t> numFinished(0);
+
+	std::vector<std::thread> producers;
+	for (uint32_t p = 0; p < NumProducers; ++p)
+	{
+		producers.emplace_back([&, p]
+		{
+			for (uint32_t i = 0; i < NumPushesPerProducer; ++i)
+			{
+				queue.Push({ p, i });
+			}
+
+			numFinished.fetch_add(1, std::memory_order_release);
+		});
+	}
+
+	// Consume while the producers are still pushing.
+	std::vector<uint32_t> nextSequence(NumProducers, 0);
+	bool inOrder = true;
+	size_t numConsumed = 0;
+
+	auto consume = [&](Item&& item)
+	{
+		inOrder &= item.Sequence == nextSequence[item.Producer];
+		nextSequence[item.Producer] = item.Sequence + 1;
+	};
+
+	while (numFinished.load(std::memory_order_acquire) < NumProducers)
+	{
+		numConsumed += queue.ConsumeAll(consume);
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	numConsumed += queue.ConsumeAll(consume);
+
+	CHECK(inOrder);
+	CHECK(numConsumed == NumProducers * NumPushesPerProducer);
+	CHECK(queue.IsEmpty());
+}
+
+// Callbacks run outside the callback lock, but batches taken by the
+// completion thread and by threads waiting on the queue must still run one
+// at a time in fence order.
+DEVICE_TEST(CommandQueueRunsCallbacksInOrderAcrossThreads)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+
+	std::mutex orderMutex;
+	std::vector<uint32_t> order;
+	std::atomic<uint32_t> numRunning(0);
+	std::atomic<bool> overlapped(false);
+
+	QueueGate gate(*queue);
+
+	uint64_t lastFenceValue = 0;
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		lastFenceValue = queue->Signal();
+		queue->OnFenceComplete(lastFenceValue, [&, i]
+		{
+			if (numRunning.fetch_add(1) != 0)
+			{
+				overlapped = true;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(orderMutex);
+				order.push_back(i);
+			}
+			numRunning.fetch_sub(1);
+		});
+	}
+
+	// Several threads wait on the same fence at once. Each records how many
+	// callbacks had run when its wait returned; the checks run here.
+	const int NumWaiters = 4;
+	std::vector<size_t> numRunOnReturn(NumWaiters);
+	std::vector<std::thread> waiters;
+	for (int t = 0; t < NumWaiters; ++t)
+	{
+		waiters.emplace_back([&, t]
+		{
+			queue->WaitForFenceValue(lastFenceValue);
+
+			std::lock_guard<std::mutex> lock(orderMutex);
+			numRunOnReturn[t] = order.size();
+		});
+	}
+
+	gate.Release();
+
+	for (auto& waiter : waiters)
+	{
+		waiter.join();
+	}
+
+	// Every waiter returns only after every callback up to its fence ran.
+	for (size_t numRun : numRunOnReturn)
+	{
+		CHECK(numRun == 256);
+	}
+	CHECK(!overlapped);
+	for (uint32_t i = 0; i < order.size(); ++i)
+	{
+		CHECK(order[i] == i);
+	}
+}
@@ -0,0 +1,128 @@
+#include "TestFramework.h"
+
+#include "../Core/Application.h"
+#include "../Core/System/CommandQueue.h"
+#include "../Core/System/ParallelRecordingContext.h"
+#include "../Core/System/Timer.h"
+#include "../Core/System/UploadBuffer.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct DrawConstants
+	{
+		float World[16];
+	};
+
+	// Stands in for per-draw CPU work: building a transform, writing it to
+	// upload memory and recording the draw.
+	void RecordDraws(ID3D12GraphicsCommandList2* commandList, UploadBuffer& uploadBuffer, uint32_t firstDraw, uint32_t numDraws)
+	{
+		for (uint32_t draw = firstDraw; draw < firstDraw + numDraws; ++draw)
+		{
+			float angle = draw * 0.001f;
+
+			DrawConstants constants = {};
+			constants.World[0] = std::cos(angle);
+			constants.World[2] = std::sin(angle);
+			constants.World[5] = 1.0f;
+			constants.World[8] = -std::sin(angle);
+			constants.World[10] = std::cos(angle);
+			constants.World[12] = static_cast<float>(draw % 100);
+			constants.World[15] = 1.0f;
+
+			commandList->SetGraphicsRootConstantBufferView(0, uploadBuffer.Emplace<DrawConstants>(constants));
+			commandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
+		}
+	}
+}
+
+DEVICE_TEST(ParallelRecordingContextRunsEverySlotAndRethrows)
+{
+	auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	ParallelRecordingContext context(commandQueue, 4);
+
+	// CHECK throws, so workers only record what they saw and the checks run
+	// here.
+	std::vector<std::atomic<uint32_t>> calls(context.GetNumSlots());
+	std::vector<std::atomic<bool>> hadCommandList(context.GetNumSlots());
+	context.Record([&](uint32_t slot, ID3D12GraphicsCommandList2* commandList)
+	{
+		hadCommandList[slot] = commandList != nullptr;
+		++calls[slot];
+	});
+
+	for (uint32_t slot = 0; slot < context.GetNumSlots(); ++slot)
+	{
+		CHECK(calls[slot] == 1);
+		CHECK(hadCommandList[slot]);
+	}
+
+	bool threw = false;
+	try
+	{
+		context.Record([](uint32_t slot, ID3D12GraphicsCommandList2*)
+		{
+			if (slot == 2)
+			{
+				throw std::runtime_error("slot failed");
+			}
+		});
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+
+	CHECK(threw);
+
+	commandQueue->WaitForFenceValue(context.Submit());
+}
+
+BENCHMARK(ParallelRecordingContextDraws)
+{
+	const uint32_t NumDraws = 100000;
+	const int NumFrames = 10;
+
+	auto commandQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	UploadBuffer uploadBuffer(_2MB);
+
+	std::vector<uint32_t> slotCounts = { 1, 2, 4, 8 };
+	uint32_t numCores = std::thread::hardware_concurrency();
+	if (numCores > 8)
+	{
+		slotCounts.push_back(numCores);
+	}
+
+	for (uint32_t numSlots : slotCounts)
+	{
+		ParallelRecordingContext context(commandQueue, numSlots);
+
+		double totalMilliseconds = 0.0;
+		for (int frame = 0; frame < NumFrames; ++frame)
+		{
+			Timer timer;
+			context.Record([&](uint32_t slot, ID3D12GraphicsCommandList2* commandList)
+			{
+				uint32_t firstDraw = NumDraws * slot / numSlots;
+				uint32_t lastDraw = NumDraws * (slot + 1) / numSlots;
+				RecordDraws(commandList, uploadBuffer, firstDraw, lastDraw - firstDraw);
+			});
+			uint64_t fenceValue = context.Submit();
+			timer.Tick();
+
+			totalMilliseconds += timer.GetDeltaMilliseconds();
+
+			commandQueue->WaitForFenceValue(fenceValue);
+			uploadBuffer.Reset();
+		}
+
+		printf("ParallelRecordingContext %2u slots: %8.3f ms per %u draws\n", numSlots, totalMilliseconds / NumFrames, NumDraws);
+	}
+}
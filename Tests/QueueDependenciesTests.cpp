@@ -0,0 +1,121 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/QueueDependencies.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+// Steps a copy -> compute -> direct hand-off while the copy queue is held
+// behind a gate only the CPU opens. If any call along the way waited on the
+// CPU for another queue it would never return, so the hand-off runs on a
+// separate thread with a deadline.
+DEVICE_TEST(QueueDependenciesNeverBlockTheCpu)
+{
+	auto copyQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
+	auto computeQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+	auto directQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+	uint64_t computeWaits = computeQueue->GetStatistics().NumWaits;
+	uint64_t directWaits = directQueue->GetStatistics().NumWaits;
+
+	QueueGate gate(*copyQueue);
+
+	struct Timeline
+	{
+		uint64_t Copy;
+		uint64_t Compute;
+		uint64_t Direct;
+	};
+
+	auto handOff = std::async(std::launch::async, [&]
+	{
+		Timeline timeline;
+		timeline.Copy = copyQueue->Signal();
+
+		QueueDependencies computeDependencies;
+		computeDependencies.Add(*copyQueue, timeline.Copy);
+		computeDependencies.Apply(*computeQueue);
+		timeline.Compute = computeQueue->Signal();
+
+		// The direct queue depends on both; the copy wait is already implied
+		// by compute's but is still issued, since the queues don't know that.
+		QueueDependencies directDependencies;
+		directDependencies.Add(*copyQueue, timeline.Copy);
+		directDependencies.Add(*computeQueue, timeline.Compute);
+		directDependencies.Add(*directQueue, directQueue->GetLastSignalledFenceValue());
+		directDependencies.Apply(*directQueue);
+		timeline.Direct = directQueue->Signal();
+
+		return timeline;
+	});
+
+	bool returned = handOff.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+	if (!returned)
+	{
+		gate.Release();
+	}
+
+	CHECK(returned);
+
+	Timeline timeline = handOff.get();
+
+	// Everything is still queued behind the copy queue's gate.
+	CHECK(!copyQueue->IsFenceComplete(timeline.Copy));
+	CHECK(!computeQueue->IsFenceComplete(timeline.Compute));
+	CHECK(!directQueue->IsFenceComplete(timeline.Direct));
+	CHECK(computeQueue->GetStatistics().NumWaits == computeWaits + 1);
+	CHECK(directQueue->GetStatistics().NumWaits == directWaits + 2);
+
+	gate.Release();
+	directQueue->WaitForFenceValue(timeline.Direct);
+
+	CHECK(copyQueue->IsFenceComplete(timeline.Copy));
+	CHECK(computeQueue->IsFenceComplete(timeline.Compute));
+}
+
+DEVICE_TEST(CommandQueueWaitFromSeveralThreads)
+{
+	auto copyQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
+	auto directQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+	QueueGate gate(*copyQueue);
+
+	std::vector<uint64_t> fenceValues;
+	for (int i = 0; i < 8; ++i)
+	{
+		fenceValues.push_back(copyQueue->Signal());
+	}
+
+	uint64_t directWaits = directQueue->GetStatistics().NumWaits;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t)
+	{
+		threads.emplace_back([&]
+		{
+			for (uint64_t fenceValue : fenceValues)
+			{
+				directQueue->Wait(*copyQueue, fenceValue);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	// Waits already covered by a later one are skipped, so at most one per
+	// fence value is issued however the threads interleave.
+	uint64_t numWaits = directQueue->GetStatistics().NumWaits - directWaits;
+	CHECK(numWaits >= 1 && numWaits <= fenceValues.size());
+
+	uint64_t directFence = directQueue->Signal();
+	CHECK(!directQueue->IsFenceComplete(directFence));
+
+	gate.Release();
+	directQueue->WaitForFenceValue(directFence);
+}
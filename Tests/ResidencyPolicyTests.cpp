@@ -0,0 +1,167 @@
+#include "TestFramework.h"
+
+#include "../Core/System/Memory/ResidencyPolicy.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	enum Queue : uint32_t
+	{
+		Queue_Direct,
+		Queue_Compute,
+		Queue_Copy,
+	};
+
+	bool Contains(const std::vector<uint32_t>& objects, uint32_t object)
+	{
+		return std::find(objects.begin(), objects.end(), object) != objects.end();
+	}
+}
+
+TEST(ResidencyPolicyKeepsObjectsBusyOnAnyQueue)
+{
+	ResidencyPolicy policy;
+	uint32_t upload = policy.Add(100);
+	uint32_t a = policy.Add(100);
+	uint32_t b = policy.Add(100);
+	uint32_t c = policy.Add(100);
+
+	// The upload destination is least recently used, but the copy queue is
+	// still writing it.
+	policy.MarkUsed(upload, Queue_Copy, 5);
+	policy.MarkUsed(a, Queue_Direct, 1);
+	policy.MarkUsed(b, Queue_Direct, 1);
+	policy.MarkUsed(c, Queue_Direct, 1);
+
+	const uint64_t CopyPending[ResidencyPolicy::MaxQueues] = { 1, 0, 0 };
+	auto decision = policy.Update(250, 400, CopyPending);
+	CHECK(decision.Evict.size() == 2 && decision.Evict[0] == a && decision.Evict[1] == b);
+	CHECK(policy.IsResident(upload));
+
+	const uint64_t CopyDone[ResidencyPolicy::MaxQueues] = { 1, 0, 5 };
+	decision = policy.Update(150, 200, CopyDone);
+	CHECK(decision.Evict.size() == 1 && decision.Evict[0] == upload);
+
+	// Marking an evicted object brings it back before anything is evicted.
+	policy.MarkUsed(a, Queue_Compute, 3);
+	decision = policy.Update(1000, 100, CopyDone);
+	CHECK(decision.MakeResident.size() == 1 && decision.MakeResident[0] == a);
+	CHECK(decision.Evict.empty());
+
+	auto stats = policy.GetStatistics();
+	CHECK(stats.NumResident == 2 && stats.ResidentBytes == 200 && stats.EvictedBytes == 200);
+	CHECK(stats.NumEvictions == 3 && stats.NumMadeResident == 1);
+}
+
+TEST(ResidencyPolicyKeepsPendingMarksBusyUntilResolved)
+{
+	ResidencyPolicy policy;
+	uint32_t frame = policy.Add(100);
+	uint32_t other = policy.Add(100);
+
+	// The frame's heap is least recently used, but its submission has not
+	// happened yet, so no completed value can make it idle.
+	policy.MarkUsedPending(frame, Queue_Direct);
+	policy.MarkUsed(other, Queue_Direct, 1);
+	policy.MarkUsed(frame, Queue_Copy, 1);
+
+	const uint64_t Completed[ResidencyPolicy::MaxQueues] = { 1000, 0, 1000 };
+	auto decision = policy.Update(0, 200, Completed);
+	CHECK(decision.Evict.size() == 1 && decision.Evict[0] == other);
+	CHECK(policy.IsResident(frame));
+
+	policy.ResolvePending(Queue_Direct, 1001);
+	decision = policy.Update(0, 100, Completed);
+	CHECK(decision.Evict.empty());
+
+	const uint64_t FrameDone[ResidencyPolicy::MaxQueues] = { 1001, 0, 1000 };
+	decision = policy.Update(0, 100, FrameDone);
+	CHECK(decision.Evict.size() == 1 && decision.Evict[0] == frame);
+}
+
+// Feeds the policy a budget that shrinks and recovers over a run of frames,
+// with the reported usage derived from what it chose to keep resident.
+TEST(ResidencyPolicyFollowsSimulatedBudget)
+{
+	const uint32_t NumObjects = 64;
+	const uint64_t ObjectSize = 16;
+	const uint64_t FramesInFlight = 2;
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> pickObject(0, NumObjects - 1);
+	std::uniform_int_distribution<uint32_t> pickQueue(0, ResidencyPolicy::MaxQueues - 1);
+
+	ResidencyPolicy policy;
+	for (uint32_t i = 0; i < NumObjects; ++i)
+	{
+		policy.Add(ObjectSize);
+	}
+
+	std::vector<uint64_t> lastUses(NumObjects * ResidencyPolicy::MaxQueues, 0);
+	uint64_t completedFenceValues[ResidencyPolicy::MaxQueues] = {};
+
+	for (uint64_t frame = 1; frame <= 400; ++frame)
+	{
+		uint64_t budget = ObjectSize * (frame % 200 < 100 ? 48 - frame % 100 / 3 : 16 + frame % 100 / 3);
+
+		std::vector<uint32_t> used;
+		for (int i = 0; i < 12; ++i)
+		{
+			uint32_t object = pickObject(random);
+			uint32_t queue = pickQueue(random);
+
+			policy.MarkUsed(object, queue, frame);
+			lastUses[object * ResidencyPolicy::MaxQueues + queue] = frame;
+			used.push_back(object);
+		}
+
+		uint64_t usage = policy.GetStatistics().ResidentBytes;
+		auto decision = policy.Update(budget, usage, completedFenceValues);
+
+		for (uint32_t object : decision.Evict)
+		{
+			CHECK(!Contains(decision.MakeResident, object));
+			for (uint32_t queue = 0; queue < ResidencyPolicy::MaxQueues; ++queue)
+			{
+				CHECK(lastUses[object * ResidencyPolicy::MaxQueues + queue] <= completedFenceValues[queue]);
+			}
+		}
+
+		for (uint32_t object : used)
+		{
+			CHECK(policy.IsResident(object));
+		}
+
+		// Only objects a queue hasn't finished with may keep usage over budget.
+		auto stats = policy.GetStatistics();
+		if (stats.ResidentBytes > budget)
+		{
+			uint64_t busyBytes = 0;
+			for (uint32_t object = 0; object < NumObjects; ++object)
+			{
+				bool busy = false;
+				for (uint32_t queue = 0; queue < ResidencyPolicy::MaxQueues; ++queue)
+				{
+					busy |= lastUses[object * ResidencyPolicy::MaxQueues + queue] > completedFenceValues[queue];
+				}
+
+				busyBytes += busy && policy.IsResident(object) ? ObjectSize : 0;
+			}
+
+			CHECK(stats.ResidentBytes == busyBytes);
+		}
+
+		// Each queue lags the CPU by a different amount.
+		for (uint32_t queue = 0; queue < ResidencyPolicy::MaxQueues; ++queue)
+		{
+			uint64_t lag = FramesInFlight + queue;
+			completedFenceValues[queue] = frame > lag ? frame - lag : 0;
+		}
+	}
+
+	auto stats = policy.GetStatistics();
+	CHECK(stats.NumEvictions > 0 && stats.NumMadeResident > 0);
+}
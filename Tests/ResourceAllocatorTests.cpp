@@ -0,0 +1,25 @@
+#include "TestFramework.h"
+
+#include "../Core/System/Memory/ResourceAllocator.h"
+#include "../Core/Globals/d3dx12.h"
+
+DEVICE_TEST(ResourceAllocatorRejectsInvalidDescription)
+{
+	ResourceAllocator allocator(_KB(256));
+
+	D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(_KB(64));
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+
+	bool threw = false;
+	try
+	{
+		allocator.CreateResource(D3D12_HEAP_TYPE_DEFAULT, desc, D3D12_RESOURCE_STATE_COMMON);
+	}
+	catch (const std::exception&)
+	{
+		threw = true;
+	}
+
+	CHECK(threw);
+	CHECK(allocator.GetStatistics(D3D12_HEAP_TYPE_DEFAULT).NumBlocks == 0);
+}
@@ -0,0 +1,114 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/ResourceStateTracker.h"
+
+namespace
+{
+	const UINT NumMips = 4;
+
+	ComPtr<ID3D12Resource> CreateTexture(D3D12_RESOURCE_STATES initialState)
+	{
+		auto device = Application::Get().GetDevice();
+
+		ComPtr<ID3D12Resource> texture;
+		auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		auto textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, NumMips);
+		ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc,
+			initialState, nullptr, IID_PPV_ARGS(&texture)));
+
+		ResourceStateTracker::AddGlobalResourceState(texture.Get(), initialState);
+		return texture;
+	}
+
+	struct SubmissionCounts
+	{
+		uint64_t NumBarriers;
+		uint64_t NumCommandLists;
+	};
+
+	// Records one list through tracker and returns how many barriers and
+	// lists its submission took.
+	template<typename Record>
+	SubmissionCounts SubmitTracked(CommandQueue& queue, ResourceStateTracker& tracker, Record record)
+	{
+		uint64_t barriersBefore = tracker.GetStatistics().NumBarriers;
+		uint64_t listsBefore = queue.GetStatistics().NumCommandLists;
+
+		const ComPtr<ID3D12GraphicsCommandList2> commandLists[] = { queue.GetCommandList() };
+		ResourceStateTracker* const stateTrackers[] = { &tracker };
+
+		record(commandLists[0].Get());
+		queue.WaitForFenceValue(queue.ExecuteCommandLists(commandLists, stateTrackers, 1));
+
+		return { tracker.GetStatistics().NumBarriers - barriersBefore, queue.GetStatistics().NumCommandLists - listsBefore };
+	}
+}
+
+DEVICE_TEST(ResourceStateTrackerLeavesUnusedSubresourcesUnknown)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	auto texture = CreateTexture(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	ResourceStateTracker tracker;
+
+	// One mip, then the whole texture on the same list: the other mips are
+	// already shader resources, so only mip 0 needs barriers.
+	auto counts = SubmitTracked(*queue, tracker, [&](ID3D12GraphicsCommandList2* commandList)
+	{
+		tracker.TransitionResource(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, 0);
+		tracker.FlushResourceBarriers(commandList);
+		tracker.TransitionResource(texture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		tracker.FlushResourceBarriers(commandList);
+	});
+
+	CHECK(counts.NumBarriers == 2);
+	CHECK(counts.NumCommandLists == 2);
+
+	// A list that only touches mip 2 must not commit the rest as common.
+	counts = SubmitTracked(*queue, tracker, [&](ID3D12GraphicsCommandList2* commandList)
+	{
+		tracker.TransitionResource(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, 2);
+		tracker.FlushResourceBarriers(commandList);
+	});
+
+	CHECK(counts.NumBarriers == 1);
+
+	counts = SubmitTracked(*queue, tracker, [&](ID3D12GraphicsCommandList2* commandList)
+	{
+		tracker.TransitionResource(texture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		tracker.FlushResourceBarriers(commandList);
+	});
+
+	CHECK(counts.NumBarriers == 1);
+
+	ResourceStateTracker::RemoveGlobalResourceState(texture.Get());
+}
+
+DEVICE_TEST(ResourceStateTrackerSkipsListForNoOpFirstUse)
+{
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	auto texture = CreateTexture(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	ResourceStateTracker tracker;
+
+	auto counts = SubmitTracked(*queue, tracker, [&](ID3D12GraphicsCommandList2* commandList)
+	{
+		tracker.TransitionResource(texture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		tracker.FlushResourceBarriers(commandList);
+	});
+
+	CHECK(counts.NumBarriers == 0);
+	CHECK(counts.NumCommandLists == 1);
+
+	counts = SubmitTracked(*queue, tracker, [&](ID3D12GraphicsCommandList2* commandList)
+	{
+		tracker.TransitionResource(texture.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+		tracker.FlushResourceBarriers(commandList);
+	});
+
+	CHECK(counts.NumBarriers == 1);
+	CHECK(counts.NumCommandLists == 2);
+
+	ResourceStateTracker::RemoveGlobalResourceState(texture.Get());
+}
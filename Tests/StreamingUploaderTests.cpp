@@ -0,0 +1,76 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/StreamingUploader.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+DEVICE_TEST(StreamingUploaderWrapsTheRingAndStallsOnlyWhenFull)
+{
+	const size_t ChunkSize = 256 * 1024;
+	auto copyQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
+	auto device = Application::Get().GetDevice();
+
+	ComPtr<ID3D12Resource> destination;
+	auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(8 * ChunkSize);
+	ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&destination)));
+
+	std::vector<uint8_t> data(ChunkSize, 0x3C);
+
+	// Four chunks of ring; every upload fills a chunk and is submitted at once.
+	StreamingUploader uploader(copyQueue, 4 * ChunkSize, ChunkSize);
+	const auto& stats = uploader.GetStatistics();
+	uint64_t submissionsBefore = copyQueue->GetStatistics().NumSubmissions;
+
+	auto upload = [&](UINT64 chunk)
+	{
+		uploader.UploadBuffer(destination.Get(), chunk * ChunkSize, data.data(), ChunkSize);
+	};
+
+	// Chunks 0 and 1 stay in flight behind the first gate, chunk 2 behind the
+	// second.
+	QueueGate firstGate(*copyQueue);
+	upload(0);
+	upload(1);
+	uint64_t secondChunkFence = uploader.Submit();
+
+	QueueGate secondGate(*copyQueue);
+	upload(2);
+
+	firstGate.Release();
+	copyQueue->WaitForFenceValue(secondChunkFence);
+
+	// The tail has moved past chunk 1: chunk 3 fills the end of the ring, and
+	// chunks 4 and 5 wrap round into the space chunks 0 and 1 used.
+	upload(3);
+	upload(4);
+	upload(5);
+	CHECK(stats.Stalls == 0);
+
+	// The ring is now full up to chunk 2, so the next upload has to wait for
+	// it. Open the gate only once that upload is under way.
+	std::thread releaser([&]()
+	{
+		while (copyQueue->GetStatistics().NumSubmissions < submissionsBefore + 6)
+		{
+			std::this_thread::yield();
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		secondGate.Release();
+	});
+
+	upload(6);
+	releaser.join();
+
+	copyQueue->WaitForFenceValue(uploader.Submit());
+
+	CHECK(stats.Stalls == 1);
+	CHECK(stats.Submissions == 7);
+	CHECK(stats.CopiesRecorded == 7);
+	CHECK(stats.StagingResourcesCreated == 1);
+}
@@ -0,0 +1,273 @@
+#include "TestFramework.h"
+
+#include "../Core/System/TLSFFreeList.h"
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// The map and multimap free list DescriptorAllocatorPage used before the
+	// TLSF engine, kept as the reference the engine is checked against.
+	class MapFreeList
+	{
+	public:
+		explicit MapFreeList(uint32_t capacity)
+		{
+			AddNewBlock(0, capacity);
+		}
+
+		// Best fit: the smallest free block that holds size.
+		uint32_t Allocate(uint32_t size)
+		{
+			auto smallestBlockIt = m_FreeListBySize.lower_bound(size);
+			if (smallestBlockIt == m_FreeListBySize.end())
+			{
+				return TLSFFreeList::InvalidOffset;
+			}
+
+			uint32_t offset = smallestBlockIt->second->first;
+			Claim(offset, size);
+			return offset;
+		}
+
+		// Takes [offset, offset + size) out of the free block holding it, so the
+		// reference can follow placements chosen by the engine. False if the
+		// range isn't entirely free.
+		bool Claim(uint32_t offset, uint32_t size)
+		{
+			auto blockIt = m_FreeListByOffset.upper_bound(offset);
+			if (blockIt == m_FreeListByOffset.begin())
+			{
+				return false;
+			}
+
+			--blockIt;
+
+			uint32_t blockOffset = blockIt->first;
+			uint32_t blockSize = blockIt->second.Size;
+			if (offset + size > blockOffset + blockSize)
+			{
+				return false;
+			}
+
+			m_FreeListBySize.erase(blockIt->second.FreeListBySizeIt);
+			m_FreeListByOffset.erase(blockIt);
+
+			if (offset > blockOffset)
+			{
+				AddNewBlock(blockOffset, offset - blockOffset);
+			}
+
+			if (offset + size < blockOffset + blockSize)
+			{
+				AddNewBlock(offset + size, blockOffset + blockSize - offset - size);
+			}
+
+			return true;
+		}
+
+		void FreeBlock(uint32_t offset, uint32_t numDescriptors)
+		{
+			auto nextBlockIt = m_FreeListByOffset.upper_bound(offset);
+			auto prevBlockIt = nextBlockIt;
+
+			if (prevBlockIt != m_FreeListByOffset.begin())
+			{
+				--prevBlockIt;
+			}
+			else
+			{
+				prevBlockIt = m_FreeListByOffset.end();
+			}
+
+			if (prevBlockIt != m_FreeListByOffset.end() &&
+				offset == prevBlockIt->first + prevBlockIt->second.Size)
+			{
+				offset = prevBlockIt->first;
+				numDescriptors += prevBlockIt->second.Size;
+
+				m_FreeListBySize.erase(prevBlockIt->second.FreeListBySizeIt);
+				m_FreeListByOffset.erase(prevBlockIt);
+			}
+
+			if (nextBlockIt != m_FreeListByOffset.end() &&
+				offset + numDescriptors == nextBlockIt->first)
+			{
+				numDescriptors += nextBlockIt->second.Size;
+
+				m_FreeListBySize.erase(nextBlockIt->second.FreeListBySizeIt);
+				m_FreeListByOffset.erase(nextBlockIt);
+			}
+
+			AddNewBlock(offset, numDescriptors);
+		}
+
+		bool HasSpace(uint32_t size) const
+		{
+			return m_FreeListBySize.lower_bound(size) != m_FreeListBySize.end();
+		}
+
+		uint32_t LargestFreeBlock() const
+		{
+			return m_FreeListBySize.empty() ? 0 : m_FreeListBySize.rbegin()->first;
+		}
+
+		size_t NumFreeBlocks() const { return m_FreeListByOffset.size(); }
+
+	private:
+		struct FreeBlockInfo;
+		using FreeListByOffset = std::map<uint32_t, FreeBlockInfo>;
+		using FreeListBySize = std::multimap<uint32_t, FreeListByOffset::iterator>;
+
+		struct FreeBlockInfo
+		{
+			FreeBlockInfo(uint32_t size) : Size(size) {}
+
+			uint32_t Size;
+			FreeListBySize::iterator FreeListBySizeIt;
+		};
+
+		void AddNewBlock(uint32_t offset, uint32_t numDescriptors)
+		{
+			auto offsetIt = m_FreeListByOffset.emplace(offset, numDescriptors);
+			auto sizeIt = m_FreeListBySize.emplace(numDescriptors, offsetIt.first);
+			offsetIt.first->second.FreeListBySizeIt = sizeIt;
+		}
+
+		FreeListByOffset m_FreeListByOffset;
+		FreeListBySize m_FreeListBySize;
+	};
+
+	struct Range
+	{
+		uint32_t Offset;
+		uint32_t Size;
+	};
+
+	// The TLSF queries only look at class heads, so they may understate the
+	// largest block by less than one class, i.e. 1/16 of its size.
+	void CheckSameFreeSpace(const TLSFFreeList& freeList, const MapFreeList& reference, uint32_t capacity)
+	{
+		uint32_t largest = freeList.LargestFreeBlock();
+		uint32_t referenceLargest = reference.LargestFreeBlock();
+		CHECK(largest <= referenceLargest && referenceLargest - largest <= referenceLargest / 16);
+
+		for (uint32_t size = 1; size <= capacity; size += size < 64 ? 1 : size / 8)
+		{
+			CHECK(freeList.HasSpace(size) == (size <= largest));
+			CHECK(!freeList.HasSpace(size) || reference.HasSpace(size));
+		}
+	}
+}
+
+TEST(TLSFFreeListMatchesMapFreeListOnCoalescing)
+{
+	const uint32_t Capacity = 64;
+	TLSFFreeList freeList(Capacity);
+	MapFreeList reference(Capacity);
+
+	// With one free block of each size, best fit and the TLSF classes agree
+	// on every placement.
+	const uint32_t Sizes[] = { 4, 8, 4, 16, 2 };
+	std::vector<Range> ranges;
+	for (uint32_t size : Sizes)
+	{
+		uint32_t offset = freeList.Allocate(size);
+		CHECK(offset == reference.Allocate(size));
+		ranges.push_back({ offset, size });
+	}
+
+	// Free both neighbours of ranges[1] first, then ranges[1], which has to
+	// merge with the blocks on either side.
+	freeList.Free(ranges[0].Offset, ranges[0].Size);
+	reference.FreeBlock(ranges[0].Offset, ranges[0].Size);
+	freeList.Free(ranges[2].Offset, ranges[2].Size);
+	reference.FreeBlock(ranges[2].Offset, ranges[2].Size);
+	CheckSameFreeSpace(freeList, reference, Capacity);
+	CHECK(reference.NumFreeBlocks() == 3);
+
+	freeList.Free(ranges[1].Offset, ranges[1].Size);
+	reference.FreeBlock(ranges[1].Offset, ranges[1].Size);
+	CheckSameFreeSpace(freeList, reference, Capacity);
+	CHECK(reference.NumFreeBlocks() == 2);
+	CHECK(freeList.Allocate(16) == reference.Allocate(16));
+
+	// Sub-ranges of one allocation can be freed independently.
+	freeList.Free(ranges[3].Offset + 8, 8);
+	reference.FreeBlock(ranges[3].Offset + 8, 8);
+	freeList.Free(ranges[3].Offset, 8);
+	reference.FreeBlock(ranges[3].Offset, 8);
+	CheckSameFreeSpace(freeList, reference, Capacity);
+}
+
+TEST(TLSFFreeListMatchesMapFreeListOnRandomWorkload)
+{
+	const uint32_t Capacity = 4096;
+	TLSFFreeList freeList(Capacity);
+	MapFreeList reference(Capacity);
+
+	std::mt19937 random(1234);
+	std::vector<Range> live;
+
+	for (uint32_t step = 0; step < 20000; ++step)
+	{
+		bool allocate = live.empty() || random() % 100 < 55;
+		if (allocate)
+		{
+			// Mostly single descriptors and small tables, sometimes a large block.
+			uint32_t size = random() % 10 == 0 ? 1 + random() % 512 : 1 + random() % 16;
+
+			// The engine places blocks by class rather than exact best fit, so the
+			// reference follows its placement. A request fits exactly when the
+			// reported largest block does.
+			bool fits = size <= freeList.LargestFreeBlock();
+			uint32_t offset = freeList.Allocate(size);
+
+			CHECK((offset != TLSFFreeList::InvalidOffset) == fits);
+			if (offset != TLSFFreeList::InvalidOffset)
+			{
+				CHECK(reference.Claim(offset, size));
+				live.push_back({ offset, size });
+			}
+		}
+		else
+		{
+			size_t index = random() % live.size();
+			Range range = live[index];
+			live[index] = live.back();
+			live.pop_back();
+
+			// Free a leading part on its own now and then, as thread caches do.
+			if (range.Size > 1 && random() % 4 == 0)
+			{
+				uint32_t head = 1 + random() % (range.Size - 1);
+				freeList.Free(range.Offset, head);
+				reference.FreeBlock(range.Offset, head);
+				live.push_back({ range.Offset + head, range.Size - head });
+			}
+			else
+			{
+				freeList.Free(range.Offset, range.Size);
+				reference.FreeBlock(range.Offset, range.Size);
+			}
+		}
+
+		if (step % 64 == 0)
+		{
+			CheckSameFreeSpace(freeList, reference, Capacity);
+		}
+	}
+
+	for (const auto& range : live)
+	{
+		freeList.Free(range.Offset, range.Size);
+		reference.FreeBlock(range.Offset, range.Size);
+	}
+
+	CHECK(reference.NumFreeBlocks() == 1);
+	CHECK(freeList.LargestFreeBlock() == Capacity);
+	CHECK(freeList.Allocate(Capacity) == 0);
+}
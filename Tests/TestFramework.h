@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// A minimal self-registering test runner. Tests stop at the first failed
+// CHECK; benchmarks print their own results and only run with --benchmarks.
+namespace Test
+{
+	enum class Kind
+	{
+		Test,
+		DeviceTest,
+		Benchmark
+	};
+
+	struct Case
+	{
+		const char* Name;
+		Kind Type;
+		void (*Function)();
+	};
+
+	struct Failure
+	{
+		const char* File;
+		int Line;
+		std::string Expression;
+	};
+
+	std::vector<Case>& GetRegistry();
+
+	struct Registrar
+	{
+		Registrar(const char* name, Kind type, void (*function)())
+		{
+			GetRegistry().push_back({ name, type, function });
+		}
+	};
+}
+
+#define TEST_REGISTER_CASE(name, kind) \
+	static void name(); \
+	static Test::Registrar name##_Registrar(#name, kind, &name); \
+	static void name()
+
+// Runs without a device.
+#define TEST(name) TEST_REGISTER_CASE(name, Test::Kind::Test)
+
+// Runs after Application::Create, against the real device and queues.
+#define DEVICE_TEST(name) TEST_REGISTER_CASE(name, Test::Kind::DeviceTest)
+
+// Runs after Application::Create when --benchmarks is passed.
+#define BENCHMARK(name) TEST_REGISTER_CASE(name, Test::Kind::Benchmark)
+
+#define CHECK(expression) \
+	do { if (!(expression)) throw Test::Failure{ __FILE__, __LINE__, #expression }; } while (false)
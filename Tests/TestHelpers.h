@@ -0,0 +1,36 @@
+#pragma once
+#include "../Core/Application.h"
+#include "../Core/Globals/Helpers.h"
+#include "../Core/System/CommandQueue.h"
+
+// Stalls a queue on a fence only the CPU signals, so work submitted after it
+// stays in flight until Release. Tests use it to step a queue's fence
+// timeline without depending on how fast the GPU is.
+class QueueGate
+{
+public:
+	explicit QueueGate(CommandQueue& queue)
+		: m_Released(false)
+	{
+		ThrowIfFailed(Application::Get().GetDevice()->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence)));
+		ThrowIfFailed(queue.GetCommandQueue()->Wait(m_Fence.Get(), 1));
+	}
+
+	~QueueGate()
+	{
+		Release();
+	}
+
+	void Release()
+	{
+		if (!m_Released)
+		{
+			m_Released = true;
+			ThrowIfFailed(m_Fence->Signal(1));
+		}
+	}
+
+private:
+	ComPtr<ID3D12Fence> m_Fence;
+	bool m_Released;
+};
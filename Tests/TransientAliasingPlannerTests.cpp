@@ -0,0 +1,176 @@
+#include "TestFramework.h"
+
+#include "../Core/System/Timer.h"
+#include "../Core/System/Memory/TransientAliasingPlanner.h"
+
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	const uint64_t PlacementAlignment = 64 * 1024;
+
+	struct SyntheticResource
+	{
+		uint64_t Size;
+		uint64_t Alignment;
+		uint32_t FirstPass;
+		uint32_t LastPass;
+	};
+
+	// Render targets and buffers from a few KB to a few MB, most living for a
+	// handful of passes and a few for most of the frame.
+	std::vector<SyntheticResource> MakeSyntheticFrame(std::mt19937& random, uint32_t numResources, uint32_t numPasses)
+	{
+		std::uniform_int_distribution<uint32_t> sizeIn64KB(1, 128);
+		std::uniform_int_distribution<uint32_t> pass(0, numPasses - 1);
+		std::uniform_int_distribution<uint32_t> shortLifetime(0, 4);
+		std::uniform_int_distribution<uint32_t> percent(0, 99);
+
+		std::vector<SyntheticResource> resources;
+		for (uint32_t i = 0; i < numResources; ++i)
+		{
+			uint32_t firstPass = pass(random);
+			uint32_t lifetime = percent(random) < 10 ? numPasses / 2 : shortLifetime(random);
+			uint32_t lastPass = std::min(firstPass + lifetime, numPasses - 1);
+			uint64_t alignment = percent(random) < 20 ? 4 * 1024 * 1024 : PlacementAlignment;
+
+			resources.push_back({ sizeIn64KB(random) * PlacementAlignment, alignment, firstPass, lastPass });
+		}
+
+		return resources;
+	}
+
+	void AddResources(TransientAliasingPlanner& planner, const std::vector<SyntheticResource>& resources)
+	{
+		for (const auto& resource : resources)
+		{
+			planner.AddResource(resource.Size, resource.Alignment, resource.FirstPass, resource.LastPass);
+		}
+	}
+
+	bool LivesOverlap(const SyntheticResource& a, const SyntheticResource& b)
+	{
+		return a.FirstPass <= b.LastPass && b.FirstPass <= a.LastPass;
+	}
+
+	bool MemoryOverlaps(const TransientAliasingPlanner::Plan& plan, const std::vector<SyntheticResource>& resources, size_t a, size_t b)
+	{
+		return plan.Offsets[a] < plan.Offsets[b] + resources[b].Size && plan.Offsets[b] < plan.Offsets[a] + resources[a].Size;
+	}
+}
+
+TEST(TransientAliasingPlannerSharesMemoryBetweenDisjointLifetimes)
+{
+	TransientAliasingPlanner planner;
+	uint32_t gbuffer = planner.AddResource(4 * PlacementAlignment, PlacementAlignment, 0, 1);
+	uint32_t lighting = planner.AddResource(4 * PlacementAlignment, PlacementAlignment, 1, 2);
+	uint32_t bloom = planner.AddResource(4 * PlacementAlignment, PlacementAlignment, 2, 3);
+	uint32_t tonemap = planner.AddResource(4 * PlacementAlignment, PlacementAlignment, 3, 3);
+
+	auto plan = planner.Compile();
+
+	// Each resource overlaps only its neighbours, so two slots are enough.
+	CHECK(plan.Offsets[gbuffer] != plan.Offsets[lighting]);
+	CHECK(plan.Offsets[bloom] == plan.Offsets[gbuffer]);
+	CHECK(plan.Offsets[tonemap] == plan.Offsets[lighting]);
+	CHECK(plan.HeapSize == 8 * PlacementAlignment);
+	CHECK(plan.UnaliasedSize == 16 * PlacementAlignment);
+
+	CHECK(plan.Barriers.size() == 2);
+	CHECK(plan.Barriers[0].Pass == 2 && plan.Barriers[0].After == bloom && plan.Barriers[0].Before == gbuffer);
+	CHECK(plan.Barriers[1].Pass == 3 && plan.Barriers[1].After == tonemap && plan.Barriers[1].Before == lighting);
+}
+
+TEST(TransientAliasingPlannerNamesNoPredecessorForSharedRanges)
+{
+	TransientAliasingPlanner planner;
+	uint32_t first = planner.AddResource(2 * PlacementAlignment, PlacementAlignment, 0, 0);
+	uint32_t second = planner.AddResource(PlacementAlignment, PlacementAlignment, 1, 1);
+	uint32_t third = planner.AddResource(2 * PlacementAlignment, PlacementAlignment, 2, 2);
+
+	auto plan = planner.Compile();
+
+	CHECK(plan.HeapSize == 2 * PlacementAlignment);
+	CHECK(plan.Barriers.size() == 2);
+	CHECK(plan.Barriers[0].After == second && plan.Barriers[0].Before == first);
+	CHECK(plan.Barriers[1].After == third && plan.Barriers[1].Before == TransientAliasingPlanner::InvalidResource);
+}
+
+TEST(TransientAliasingPlannerNeverOverlapsLiveResources)
+{
+	std::mt19937 random(1234);
+
+	for (int frame = 0; frame < 20; ++frame)
+	{
+		auto resources = MakeSyntheticFrame(random, 200, 40);
+
+		TransientAliasingPlanner planner;
+		AddResources(planner, resources);
+		auto plan = planner.Compile();
+
+		CHECK(plan.HeapSize <= plan.UnaliasedSize);
+
+		size_t numExpectedBarriers = 0;
+		for (size_t a = 0; a < resources.size(); ++a)
+		{
+			CHECK(plan.Offsets[a] % resources[a].Alignment == 0);
+			CHECK(plan.Offsets[a] + resources[a].Size <= plan.HeapSize);
+
+			bool reusesMemory = false;
+			for (size_t b = 0; b < resources.size(); ++b)
+			{
+				if (a == b || !MemoryOverlaps(plan, resources, a, b))
+				{
+					continue;
+				}
+
+				CHECK(!LivesOverlap(resources[a], resources[b]));
+				reusesMemory |= resources[b].LastPass < resources[a].FirstPass;
+			}
+
+			numExpectedBarriers += reusesMemory ? 1 : 0;
+		}
+
+		CHECK(plan.Barriers.size() == numExpectedBarriers);
+		for (size_t i = 0; i < plan.Barriers.size(); ++i)
+		{
+			CHECK(plan.Barriers[i].Pass == resources[plan.Barriers[i].After].FirstPass);
+			CHECK(i == 0 || plan.Barriers[i - 1].Pass <= plan.Barriers[i].Pass);
+		}
+	}
+}
+
+BENCHMARK(TransientAliasingPlannerCompile)
+{
+	const uint32_t ResourceCounts[] = { 100, 250, 500, 1000 };
+	const int NumFrames = 20;
+
+	std::mt19937 random(5678);
+
+	for (uint32_t numResources : ResourceCounts)
+	{
+		double totalMilliseconds = 0.0;
+		uint64_t totalHeapSize = 0;
+		uint64_t totalUnaliasedSize = 0;
+
+		for (int frame = 0; frame < NumFrames; ++frame)
+		{
+			auto resources = MakeSyntheticFrame(random, numResources, numResources / 5);
+
+			TransientAliasingPlanner planner;
+			AddResources(planner, resources);
+
+			Timer timer;
+			auto plan = planner.Compile();
+			timer.Tick();
+
+			totalMilliseconds += timer.GetDeltaMilliseconds();
+			totalHeapSize += plan.HeapSize;
+			totalUnaliasedSize += plan.UnaliasedSize;
+		}
+
+		printf("TransientAliasingPlanner %4u resources: %8.3f ms per frame, heap %5.1f%% of unaliased\n",
+			numResources, totalMilliseconds / NumFrames, 100.0 * totalHeapSize / totalUnaliasedSize);
+	}
+}
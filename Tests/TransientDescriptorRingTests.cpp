@@ -0,0 +1,28 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Descriptors/TransientDescriptorRing.h"
+
+#include <new>
+
+DEVICE_TEST(TransientDescriptorRingFailedAllocationKeepsSpace)
+{
+	TransientDescriptorRing ring(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 8, 2);
+
+	CHECK(ring.Allocate(6) == 0);
+
+	bool threw = false;
+	try
+	{
+		ring.Allocate(4);
+	}
+	catch (const std::bad_alloc&)
+	{
+		threw = true;
+	}
+
+	CHECK(threw);
+	CHECK(ring.GetNumAllocatedThisFrame() == 6);
+	CHECK(ring.Allocate(2) == 6);
+	CHECK(ring.GetNumAllocatedThisFrame() == 8);
+}
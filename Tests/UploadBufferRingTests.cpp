@@ -0,0 +1,37 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/UploadBufferRing.h"
+
+DEVICE_TEST(UploadBufferRingReusesPagesOnlyAfterTheirFence)
+{
+	const size_t PageSize = 64 * 1024;
+
+	auto queue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+	UploadBufferRing ring(PageSize, 2);
+
+	QueueGate gate(*queue);
+
+	// Frame 0 stays in flight behind the gate. Closing it must not wait on
+	// the CPU, since the next slice has never been used.
+	D3D12_GPU_VIRTUAL_ADDRESS frame0 = ring.Allocate(1024, 256).GPU;
+	uint64_t fence0 = queue->Signal();
+	ring.Reset(queue, fence0);
+
+	D3D12_GPU_VIRTUAL_ADDRESS frame1 = ring.Allocate(1024, 256).GPU;
+	CHECK(frame1 < frame0 || frame1 >= frame0 + PageSize);
+	CHECK(!queue->IsFenceComplete(fence0));
+
+	gate.Release();
+	queue->WaitForFenceValue(fence0);
+
+	// Frame 0's slice is recycled as frame 1 closes and its page is handed
+	// to frame 2 from the start.
+	uint64_t fence1 = queue->Signal();
+	ring.Reset(queue, fence1);
+
+	D3D12_GPU_VIRTUAL_ADDRESS frame2 = ring.Allocate(1024, 256).GPU;
+	CHECK(frame2 == frame0);
+
+	queue->WaitForFenceValue(fence1);
+}
@@ -0,0 +1,161 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Timer.h"
+#include "../Core/System/UploadBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static void AllocateOnThreads(UploadBuffer& uploadBuffer, uint32_t numThreads, uint32_t numAllocationsPerThread,
+	std::vector<std::vector<D3D12_GPU_VIRTUAL_ADDRESS>>* addresses)
+{
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			for (uint32_t i = 0; i < numAllocationsPerThread; ++i)
+			{
+				auto allocation = uploadBuffer.Allocate(256, 256);
+				if (addresses)
+				{
+					(*addresses)[t].push_back(allocation.GPU);
+				}
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+DEVICE_TEST(UploadBufferConcurrentAllocationsUseEveryPageFully)
+{
+	const size_t PageSize = 64 * 1024;
+	const uint32_t NumThreads = 8;
+	const uint32_t NumAllocationsPerThread = 2048;
+
+	UploadBuffer uploadBuffer(PageSize);
+
+	std::vector<std::vector<D3D12_GPU_VIRTUAL_ADDRESS>> addresses(NumThreads);
+	AllocateOnThreads(uploadBuffer, NumThreads, NumAllocationsPerThread, &addresses);
+
+	std::vector<D3D12_GPU_VIRTUAL_ADDRESS> allAddresses;
+	for (const auto& threadAddresses : addresses)
+	{
+		allAddresses.insert(allAddresses.end(), threadAddresses.begin(), threadAddresses.end());
+	}
+
+	std::sort(allAddresses.begin(), allAddresses.end());
+	CHECK(std::adjacent_find(allAddresses.begin(), allAddresses.end()) == allAddresses.end());
+
+	// 256 byte blocks fill pages exactly, so any page created and then
+	// dropped by a racing thread would show up here.
+	uploadBuffer.Reset();
+	CHECK(uploadBuffer.GetStatistics().NumPages == NumThreads * NumAllocationsPerThread * 256 / PageSize);
+}
+
+BENCHMARK(UploadBufferContention)
+{
+	const uint32_t ThreadCounts[] = { 1, 2, 4, 8, 16, 64 };
+	const uint32_t NumAllocations = 1 << 20;
+
+	UploadBuffer uploadBuffer(_2MB);
+
+	for (uint32_t numThreads : ThreadCounts)
+	{
+		// Warm the pool so page creation isn't measured.
+		AllocateOnThreads(uploadBuffer, 1, NumAllocations, nullptr);
+		uploadBuffer.Reset();
+
+		Timer timer;
+		AllocateOnThreads(uploadBuffer, numThreads, NumAllocations / numThreads, nullptr);
+		timer.Tick();
+
+		uploadBuffer.Reset();
+
+		printf("UploadBuffer %2u threads: %8.2f M allocations/s, %zu pages\n",
+			numThreads, NumAllocations / timer.GetDeltaSeconds() * 1e-6, uploadBuffer.GetStatistics().NumPages);
+	}
+}
+
+namespace
+{
+	struct PerDrawConstants
+	{
+		float World[16];
+		float Colour[4];
+	};
+
+	struct CountedCopy
+	{
+		CountedCopy(int value) : Value(value) {}
+		CountedCopy(const CountedCopy& other) : Value(other.Value + 1) {}
+
+		int Value;
+	};
+}
+
+DEVICE_TEST(UploadBufferEmplaceArrayCopiesBothKinds)
+{
+	UploadBuffer uploadBuffer(64 * 1024);
+
+	const PerDrawConstants constants[2] = { { { 1.0f }, { 2.0f } }, { { 3.0f }, { 4.0f } } };
+	auto allocation = uploadBuffer.Allocate(256, 256);
+	D3D12_GPU_VIRTUAL_ADDRESS gpu = uploadBuffer.EmplaceArray(constants, 2);
+	const PerDrawConstants* copiedConstants = reinterpret_cast<const PerDrawConstants*>(
+		static_cast<uint8_t*>(allocation.CPU) + (gpu - allocation.GPU));
+	CHECK(copiedConstants[0].World[0] == 1.0f && copiedConstants[1].Colour[0] == 4.0f);
+
+	// Types that are not trivially copyable go through their copy constructor.
+	const CountedCopy counted[3] = { 10, 20, 30 };
+	D3D12_GPU_VIRTUAL_ADDRESS countedGpu = uploadBuffer.EmplaceArray(counted, 3);
+	const CountedCopy* copies = reinterpret_cast<const CountedCopy*>(
+		static_cast<uint8_t*>(allocation.CPU) + (countedGpu - allocation.GPU));
+	CHECK(copies[0].Value == 11 && copies[1].Value == 21 && copies[2].Value == 31);
+}
+
+BENCHMARK(UploadBufferPerDrawConstants)
+{
+	const uint32_t NumDraws = 100000;
+
+	UploadBuffer uploadBuffer(_2MB);
+
+	PerDrawConstants constants = {};
+	constants.Colour[3] = 1.0f;
+
+	// The first pass only warms the page pool.
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		Timer timer;
+		for (uint32_t i = 0; i < NumDraws; ++i)
+		{
+			constants.World[0] = static_cast<float>(i);
+			if (pass < 2)
+			{
+				auto allocation = uploadBuffer.Allocate(sizeof(PerDrawConstants), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+				memcpy(allocation.CPU, &constants, sizeof(PerDrawConstants));
+			}
+			else
+			{
+				uploadBuffer.Emplace<PerDrawConstants>(constants);
+			}
+		}
+		timer.Tick();
+
+		uploadBuffer.Reset();
+
+		if (pass == 0)
+		{
+			continue;
+		}
+
+		printf("%-18s %u draws: %8.3f ms\n", pass == 1 ? "Allocate + memcpy" : "Emplace", NumDraws, timer.GetDeltaSeconds() * 1000.0);
+	}
+}
@@ -0,0 +1,99 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+
+#include "../Core/System/Timer.h"
+#include "../Core/System/UploadBuffer.h"
+#include "../Core/System/WriteCombinedMemory.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const WriteCombined::Kernel Kernels[] = { WriteCombined::Kernel::Memcpy, WriteCombined::Kernel::SSE2, WriteCombined::Kernel::AVX2 };
+	const char* const KernelNames[] = { "memcpy", "SSE2", "AVX2" };
+}
+
+TEST(WriteCombinedKernelsMatchMemcpy)
+{
+	const uint8_t Guard = 0xCD;
+	const size_t Padding = 64;
+
+	// Around the vector widths and loop strides, plus sizes that leave a tail.
+	const size_t Sizes[] = { 0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 200, 1000, 4099 };
+
+	std::vector<uint8_t> source(4099 + Padding);
+	for (size_t i = 0; i < source.size(); ++i)
+	{
+		source[i] = static_cast<uint8_t>(i * 31 + 7);
+	}
+
+	std::vector<uint8_t> destination(4099 + 2 * Padding);
+
+	for (size_t k = 0; k < _countof(Kernels); ++k)
+	{
+		if (!WriteCombined::IsKernelSupported(Kernels[k]))
+		{
+			continue;
+		}
+
+		for (size_t size : Sizes)
+		{
+			// Destination offsets cover every alignment of the 32 byte kernel head.
+			for (size_t destinationOffset = 0; destinationOffset < 33; ++destinationOffset)
+			{
+				size_t sourceOffset = destinationOffset % 5;
+				std::fill(destination.begin(), destination.end(), Guard);
+
+				uint8_t* target = destination.data() + Padding + destinationOffset;
+				WriteCombined::CopyWithKernel(Kernels[k], target, source.data() + sourceOffset, size);
+
+				CHECK(std::memcmp(target, source.data() + sourceOffset, size) == 0);
+				for (size_t i = 0; i < destination.size(); ++i)
+				{
+					const uint8_t* byte = destination.data() + i;
+					if (byte < target || byte >= target + size)
+					{
+						CHECK(*byte == Guard);
+					}
+				}
+			}
+		}
+	}
+}
+
+BENCHMARK(WriteCombinedCopyThroughput)
+{
+	const size_t Sizes[] = { 64, 4 * 1024, _1MB };
+	const size_t BytesPerRun = 256 * _1MB;
+
+	// Copy into mapped upload memory, which is write-combined on real hardware.
+	UploadBuffer uploadBuffer(_2MB);
+	auto allocation = uploadBuffer.Allocate(_1MB, 64);
+
+	std::vector<uint8_t> source(_1MB, 0x5A);
+
+	for (size_t size : Sizes)
+	{
+		for (size_t k = 0; k < _countof(Kernels); ++k)
+		{
+			if (!WriteCombined::IsKernelSupported(Kernels[k]))
+			{
+				continue;
+			}
+
+			size_t numCopies = BytesPerRun / size;
+
+			Timer timer;
+			for (size_t i = 0; i < numCopies; ++i)
+			{
+				WriteCombined::CopyWithKernel(Kernels[k], allocation.CPU, source.data(), size);
+			}
+			timer.Tick();
+
+			printf("%-6s %8zu bytes: %8.2f GB/s\n", KernelNames[k], size,
+				static_cast<double>(numCopies * size) / timer.GetDeltaSeconds() * 1e-9);
+		}
+	}
+}
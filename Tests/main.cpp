@@ -0,0 +1,105 @@
+#include "TestFramework.h"
+
+#include "../Core/Application.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+std::vector<Test::Case>& Test::GetRegistry()
+{
+	static std::vector<Case> registry;
+	return registry;
+}
+
+static bool RunCase(const Test::Case& testCase)
+{
+	try
+	{
+		testCase.Function();
+	}
+	catch (const Test::Failure& failure)
+	{
+		printf("FAILED %s\n  %s(%d): CHECK(%s)\n", testCase.Name, failure.File, failure.Line, failure.Expression.c_str());
+		return false;
+	}
+	catch (const std::exception& e)
+	{
+		printf("FAILED %s\n  exception: %s\n", testCase.Name, e.what());
+		return false;
+	}
+
+	if (testCase.Type != Test::Kind::Benchmark)
+	{
+		printf("passed %s\n", testCase.Name);
+	}
+
+	return true;
+}
+
+// Tests.exe [--benchmarks] [--cpu-only] [name-filter]
+int main(int argc, char** argv)
+{
+	bool runBenchmarks = false;
+	bool cpuOnly = false;
+	const char* filter = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmarks") == 0)
+		{
+			runBenchmarks = true;
+		}
+		else if (strcmp(argv[i], "--cpu-only") == 0)
+		{
+			cpuOnly = true;
+		}
+		else
+		{
+			filter = argv[i];
+		}
+	}
+
+	std::vector<const Test::Case*> cpuCases;
+	std::vector<const Test::Case*> deviceCases;
+
+	for (const auto& testCase : Test::GetRegistry())
+	{
+		if (filter && !strstr(testCase.Name, filter))
+		{
+			continue;
+		}
+
+		if (testCase.Type == Test::Kind::Test)
+		{
+			cpuCases.push_back(&testCase);
+		}
+		else if (!cpuOnly && (testCase.Type == Test::Kind::DeviceTest || runBenchmarks))
+		{
+			deviceCases.push_back(&testCase);
+		}
+	}
+
+	int numFailed = 0;
+
+	for (const auto* testCase : cpuCases)
+	{
+		numFailed += RunCase(*testCase) ? 0 : 1;
+	}
+
+	if (!deviceCases.empty())
+	{
+		Application::Create(GetModuleHandle(nullptr));
+
+		for (const auto* testCase : deviceCases)
+		{
+			numFailed += RunCase(*testCase) ? 0 : 1;
+		}
+
+		Application::Destroy();
+	}
+
+	printf("%d of %d failed\n", numFailed, static_cast<int>(cpuCases.size() + deviceCases.size()));
+
+	return numFailed == 0 ? 0 : 1;
+}